@@ -11,6 +11,7 @@
  */
 
 #include "window.hpp"
+#include "host_align.hpp"
 
 #include "libobsensor/hpp/Pipeline.hpp"
 #include "libobsensor/hpp/Error.hpp"
@@ -98,6 +99,16 @@ int main(int argc, char **argv) try {
         std::cerr << "function:" << e.getName() << "\nargs:" << e.getArgs() << "\nmessage:" << e.getMessage() << "\ntype:" << e.getExceptionType() << std::endl;
     }
 
+    // Both alignments run on the host, on mapping tables built once for the calibration and the resolutions
+    std::shared_ptr<DepthToColorAligner> hostAligner;
+    std::shared_ptr<ColorToDepthAligner> hostColorAligner;
+    if(align_to_stream == OB_STREAM_COLOR) {
+        hostAligner = std::make_shared<DepthToColorAligner>(alignCalibration(pipe.getCameraParam()), defaultExecutor());
+    }
+    else {
+        hostColorAligner = std::make_shared<ColorToDepthAligner>(alignCalibration(pipe.getCameraParam()), ALIGN_INTERPOLATION_BILINEAR, defaultExecutor());
+    }
+
     // Create a window for rendering and set the resolution of the window
     auto colorVideoProfile = colorProfile->as<ob::VideoStreamProfile>();
     Window app("AlignViewer", colorVideoProfile->width(), colorVideoProfile->height(), RENDER_OVERLAY);
@@ -114,7 +125,17 @@ int main(int argc, char **argv) try {
         auto depthFrame = frameSet->depthFrame();
 
         if(colorFrame != nullptr && depthFrame != nullptr) {
-            auto newFrame    = align.process(frameSet);
+            // The host color to depth alignment reads decoded color, the compressed formats go through the Align filter
+            std::shared_ptr<ob::Frame> newFrame;
+            if(hostAligner) {
+                newFrame = hostAligner->process(frameSet);
+            }
+            else if(hostColorAligner && ColorToDepthAligner::bytesPerPixel(colorFrame->format()) > 0) {
+                newFrame = hostColorAligner->process(frameSet);
+            }
+            else {
+                newFrame = align.process(frameSet);
+            }
             auto newFrameSet = newFrame->as<ob::FrameSet>();
             colorFrame       = newFrameSet->colorFrame();
             depthFrame       = newFrameSet->depthFrame();
@@ -126,6 +147,11 @@ int main(int argc, char **argv) try {
     // Stop the Pipeline, no frame data will be generated
     pipe.stop();
 
+    if(hostAligner) {
+        std::cout << "Align tables: " << alignTableCache().size() << ", " << alignTableCache().memoryUsage() / 1024 << " KB, aligner buffers "
+                  << hostAligner->memoryUsage() / 1024 << " KB" << std::endl;
+    }
+
     return 0;
 }
 catch(ob::Error &e) {
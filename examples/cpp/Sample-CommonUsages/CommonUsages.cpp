@@ -1,6 +1,8 @@
 #include <libobsensor/ObSensor.hpp>
 #include "utils.hpp"
 #include "window.hpp"
+#include "property_batch.hpp"
+#include "property_async.hpp"
 
 #include <mutex>
 #include <string>
@@ -13,6 +15,9 @@ std::shared_ptr<ob::Device>   device;
 std::shared_ptr<ob::Pipeline> pipeline;
 std::recursive_mutex          deviceMutex;
 
+// Exposure and gain steps are queued, so that repeated commands do not block on the device. Guarded by deviceMutex.
+std::shared_ptr<AsyncPropertyQueue> propertyQueue;
+
 std::thread inputWatchThread;
 
 bool streamStarted = false;
@@ -106,6 +111,9 @@ void handleDeviceConnected(std::shared_ptr<ob::DeviceList> devices) {
         // try to switch depth work mode
         switchDepthWorkMode();
 
+        // the device may have been reopened by switchDepthWorkMode()
+        propertyQueue = std::make_shared<AsyncPropertyQueue>(device);
+
         // try turn off hardware disparity to depth converter (switch to software d2d)
         turnOffHwD2d();
 
@@ -138,8 +146,10 @@ void handleDeviceDisconnected(std::shared_ptr<ob::DeviceList> disconnectList) {
         std::string deviceSN = disconnectList->serialNumber(i);
         std::cout << "Device disconnected, SN: " << deviceSN << std::endl;
         if(currentDevSn == deviceSN) {
-            device.reset();    // release device
-            pipeline.reset();  // release pipeline
+            std::unique_lock<std::recursive_mutex> lk(deviceMutex);
+            propertyQueue.reset();  // complete the pending property requests
+            device.reset();         // release device
+            pipeline.reset();       // release pipeline
             std::cout << "Current device disconnected" << std::endl;
         }
     }
@@ -203,26 +213,20 @@ void setDepthUnit() {
 }
 
 void setDepthValueRange() {
-    try {
-        if(device->isPropertySupported(OB_PROP_MIN_DEPTH_INT, OB_PERMISSION_WRITE)) {
-            device->setIntProperty(OB_PROP_MIN_DEPTH_INT, 30);
-            std::cout << "set depth value range-min to 30 mm" << std::endl;
-        }
-        else {
-            std::cerr << "set depth value range-min is not supported." << std::endl;
-        }
+    // Apply both values with one batch, each item reports its own status
+    PropertyBatch batch;
+    batch.setInt(OB_PROP_MIN_DEPTH_INT, 30).setInt(OB_PROP_MAX_DEPTH_INT, 10000);
 
-        if(device->isPropertySupported(OB_PROP_MAX_DEPTH_INT, OB_PERMISSION_WRITE)) {
-            device->setIntProperty(OB_PROP_MAX_DEPTH_INT, 10000);
-            std::cout << "set depth value range-max to 10000 mm" << std::endl;
+    auto results = batch.commit(device);
+    for(auto &result: results) {
+        const char *name = result.value.id == OB_PROP_MIN_DEPTH_INT ? "min" : "max";
+        if(result.status == OB_STATUS_OK) {
+            std::cout << "set depth value range-" << name << " to " << result.value.intValue << " mm" << std::endl;
         }
         else {
-            std::cerr << "set depth value range-max is not supported." << std::endl;
+            std::cerr << "set depth value range-" << name << " failed: " << result.message << std::endl;
         }
     }
-    catch(ob::Error &e) {
-        std::cerr << "function:" << e.getName() << "\nargs:" << e.getArgs() << "\nmessage:" << e.getMessage() << "\ntype:" << e.getExceptionType() << std::endl;
-    }
 }
 
 void setDepthSoftFilter() {
@@ -700,191 +704,76 @@ void switchColorMirror() {
     }
 }
 
-void setDepthExposureValue(bool increase) {
-    if(device) {
+// Step an int property by a tenth of its range, turning off auto exposure first when autoExposureId is not 0.
+// The whole read-modify-write runs on the property queue thread: the command thread does not wait for the device, and
+// since the steps run in order, each one starts from the value written by the previous one.
+void stepIntProperty(const std::string &name, OBPropertyID autoExposureId, OBPropertyID propertyId, bool increase) {
+    std::unique_lock<std::recursive_mutex> lk(deviceMutex);
+    if(!propertyQueue) {
+        return;
+    }
+    propertyQueue->post([name, autoExposureId, propertyId, increase](std::shared_ptr<ob::Device> queueDevice) {
         try {
-            if(device->isPropertySupported(OB_PROP_DEPTH_AUTO_EXPOSURE_BOOL, OB_PERMISSION_READ_WRITE)) {
-                bool value = device->getBoolProperty(OB_PROP_DEPTH_AUTO_EXPOSURE_BOOL);
+            if(autoExposureId != 0 && queueDevice->isPropertySupported(autoExposureId, OB_PERMISSION_READ_WRITE)) {
+                bool value = queueDevice->getBoolProperty(autoExposureId);
                 if(value) {
-                    device->setBoolProperty(OB_PROP_DEPTH_AUTO_EXPOSURE_BOOL, false);
-                    std::cout << "Depth AE close." << std::endl;
+                    queueDevice->setBoolProperty(autoExposureId, false);
+                    std::cout << name << " AE close." << std::endl;
                 }
             }
-            if(device->isPropertySupported(OB_PROP_DEPTH_EXPOSURE_INT, OB_PERMISSION_READ)) {
-                // get the value range
-                OBIntPropertyRange valueRange = device->getIntPropertyRange(OB_PROP_DEPTH_EXPOSURE_INT);
-                std::cout << "Depth current exposure max:" << valueRange.max << ", min:" << valueRange.min << std::endl;
-
-                int value = device->getIntProperty(OB_PROP_DEPTH_EXPOSURE_INT);
-                std::cout << "Depth current exposure:" << value << std::endl;
-                if(device->isPropertySupported(OB_PROP_DEPTH_EXPOSURE_INT, OB_PERMISSION_WRITE)) {
-                    if(increase) {
-                        value += (valueRange.max - valueRange.min) / 10;
-                        if(value > valueRange.max) {
-                            value = valueRange.max;
-                        }
-                    }
-                    else {
-                        value -= (valueRange.max - valueRange.min) / 10;
-                        if(value < valueRange.min) {
-                            value = valueRange.min;
-                        }
-                    }
-
-                    // Ensure that the value meet the step value requirements
-                    value = valueRange.min + (value - valueRange.min) / valueRange.step * valueRange.step;
-
-                    std::cout << "Set depth exposure:" << value << std::endl;
-                    device->setIntProperty(OB_PROP_DEPTH_EXPOSURE_INT, value);
-                }
-                else {
-                    std::cerr << "Depth exposure set property is not supported." << std::endl;
+            if(!queueDevice->isPropertySupported(propertyId, OB_PERMISSION_READ)) {
+                std::cerr << name << " get property is not supported." << std::endl;
+                return;
+            }
+            // get the value range
+            OBIntPropertyRange valueRange = queueDevice->getIntPropertyRange(propertyId);
+            std::cout << name << " max:" << valueRange.max << ", min:" << valueRange.min << std::endl;
+
+            int value = queueDevice->getIntProperty(propertyId);
+            std::cout << name << " current:" << value << std::endl;
+            if(!queueDevice->isPropertySupported(propertyId, OB_PERMISSION_WRITE)) {
+                std::cerr << name << " set property is not supported." << std::endl;
+                return;
+            }
+            if(increase) {
+                value += (valueRange.max - valueRange.min) / 10;
+                if(value > valueRange.max) {
+                    value = valueRange.max;
                 }
             }
             else {
-                std::cerr << "Depth exposure get property is not supported." << std::endl;
-            }
-        }
-        catch(ob::Error &e) {
-            std::cerr << "Depth AE set property is not supported." << std::endl;
-        }
-    }
-}
-
-void setColorExposureValue(bool increase) {
-    if(device) {
-        try {
-            if(device->isPropertySupported(OB_PROP_COLOR_AUTO_EXPOSURE_BOOL, OB_PERMISSION_READ_WRITE)) {
-                bool value = device->getBoolProperty(OB_PROP_COLOR_AUTO_EXPOSURE_BOOL);
-                if(value) {
-                    device->setBoolProperty(OB_PROP_COLOR_AUTO_EXPOSURE_BOOL, false);
-                    std::cout << "Color AE close." << std::endl;
+                value -= (valueRange.max - valueRange.min) / 10;
+                if(value < valueRange.min) {
+                    value = valueRange.min;
                 }
             }
 
-            if(device->isPropertySupported(OB_PROP_COLOR_EXPOSURE_INT, OB_PERMISSION_READ)) {
-                // get the value range
-                OBIntPropertyRange valueRange = device->getIntPropertyRange(OB_PROP_COLOR_EXPOSURE_INT);
-                std::cout << "Color current exposure max:" << valueRange.max << ", min:" << valueRange.min << std::endl;
-
-                int value = device->getIntProperty(OB_PROP_COLOR_EXPOSURE_INT);
-                std::cout << "Color current exposure:" << value << std::endl;
+            // Ensure that the value meet the step value requirements
+            value = valueRange.min + (value - valueRange.min) / valueRange.step * valueRange.step;
 
-                if(device->isPropertySupported(OB_PROP_COLOR_EXPOSURE_INT, OB_PERMISSION_WRITE)) {
-                    if(increase) {
-                        value += (valueRange.max - valueRange.min) / 10;
-                        if(value > valueRange.max) {
-                            value = valueRange.max;
-                        }
-                    }
-                    else {
-                        value -= (valueRange.max - valueRange.min) / 10;
-                        if(value < valueRange.min) {
-                            value = valueRange.min;
-                        }
-                    }
-
-                    // Ensure that the value meet the step value requirements
-                    value = valueRange.min + (value - valueRange.min) / valueRange.step * valueRange.step;
-
-                    std::cout << "Set color exposure:" << value << std::endl;
-                    device->setIntProperty(OB_PROP_COLOR_EXPOSURE_INT, value);
-                }
-                else {
-                    std::cerr << "Color exposure set property is not supported." << std::endl;
-                }
-            }
-            else {
-                std::cerr << "Color exposure get property is not supported." << std::endl;
-            }
+            std::cout << "Set " << name << ":" << value << std::endl;
+            queueDevice->setIntProperty(propertyId, value);
         }
         catch(ob::Error &e) {
-            std::cerr << "Color AE set property is not supported." << std::endl;
+            std::cerr << name << " set property failed: " << e.getMessage() << std::endl;
         }
-    }
+    });
 }
 
-void setDepthGainValue(bool increase) {
-    if(device) {
-        try {
-            if(device->isPropertySupported(OB_PROP_DEPTH_GAIN_INT, OB_PERMISSION_READ)) {
-                OBIntPropertyRange valueRange = device->getIntPropertyRange(OB_PROP_DEPTH_GAIN_INT);
-                std::cout << "Depth current gain max:" << valueRange.max << ", min:" << valueRange.min << std::endl;
-                int value = device->getIntProperty(OB_PROP_DEPTH_GAIN_INT);
-                std::cout << "Depth current gain:" << value << std::endl;
-                if(device->isPropertySupported(OB_PROP_DEPTH_GAIN_INT, OB_PERMISSION_WRITE)) {
-                    if(increase) {
-                        value += (valueRange.max - valueRange.min) / 10;
-                        if(value > valueRange.max) {
-                            value = valueRange.max;
-                        }
-                    }
-                    else {
-                        value -= (valueRange.max - valueRange.min) / 10;
-                        if(value < valueRange.min) {
-                            value = valueRange.min;
-                        }
-                    }
-                    // Ensure that the value meet the step value requirements
-                    value = valueRange.min + (value - valueRange.min) / valueRange.step * valueRange.step;
-
-                    std::cout << "Set depth gain:" << value << std::endl;
-                    device->setIntProperty(OB_PROP_DEPTH_GAIN_INT, value);
-                }
-                else {
-                    std::cerr << "Depth gain set property is not supported." << std::endl;
-                }
-            }
-            else {
-                std::cerr << "Depth gain get property is not supported." << std::endl;
-            }
-        }
-        catch(ob::Error &e) {
-            std::cerr << "Depth gain set property is not supported." << std::endl;
-        }
-    }
+void setDepthExposureValue(bool increase) {
+    stepIntProperty("Depth exposure", OB_PROP_DEPTH_AUTO_EXPOSURE_BOOL, OB_PROP_DEPTH_EXPOSURE_INT, increase);
 }
 
-void setColorGainValue(bool increase) {
-    if(device) {
-        try {
-            if(device->isPropertySupported(OB_PROP_COLOR_GAIN_INT, OB_PERMISSION_READ)) {
-                OBIntPropertyRange valueRange = device->getIntPropertyRange(OB_PROP_COLOR_GAIN_INT);
-                std::cout << "Color current gain max:" << valueRange.max << ", min:" << valueRange.min << std::endl;
-                int value = device->getIntProperty(OB_PROP_COLOR_GAIN_INT);
-                std::cout << "Color current gain:" << value << std::endl;
-                if(device->isPropertySupported(OB_PROP_COLOR_GAIN_INT, OB_PERMISSION_WRITE)) {
-                    if(increase) {
-                        value += (valueRange.max - valueRange.min) / 10;
-                        if(value > valueRange.max) {
-                            value = valueRange.max;
-                        }
-                    }
-                    else {
-                        value -= (valueRange.max - valueRange.min) / 10;
-                        if(value < valueRange.min) {
-                            value = valueRange.min;
-                        }
-                    }
+void setColorExposureValue(bool increase) {
+    stepIntProperty("Color exposure", OB_PROP_COLOR_AUTO_EXPOSURE_BOOL, OB_PROP_COLOR_EXPOSURE_INT, increase);
+}
 
-                    // Ensure that the value meet the step value requirements
-                    value = valueRange.min + (value - valueRange.min) / valueRange.step * valueRange.step;
+void setDepthGainValue(bool increase) {
+    stepIntProperty("Depth gain", static_cast<OBPropertyID>(0), OB_PROP_DEPTH_GAIN_INT, increase);
+}
 
-                    std::cout << "Set color gain:" << value << std::endl;
-                    device->setIntProperty(OB_PROP_COLOR_GAIN_INT, value);
-                }
-                else {
-                    std::cerr << "Color gain set property is not supported." << std::endl;
-                }
-            }
-            else {
-                std::cerr << "Color gain get property is not supported." << std::endl;
-            }
-        }
-        catch(ob::Error &e) {
-            std::cerr << "Color gain set property is not supported.: " << std::endl;
-        }
-    }
+void setColorGainValue(bool increase) {
+    stepIntProperty("Color gain", static_cast<OBPropertyID>(0), OB_PROP_COLOR_GAIN_INT, increase);
 }
 
 void printUsage() {
@@ -4,6 +4,8 @@
  */
 
 #include "window.hpp"
+#include "hdr_merge.hpp"
+#include "sequence_demux.hpp"
 
 #include "libobsensor/hpp/Pipeline.hpp"
 #include "libobsensor/hpp/Error.hpp"
@@ -29,9 +31,10 @@ int main(int argc, char **argv) try {
     auto depthProfile  = depthProfiles->getProfile(OB_PROFILE_DEFAULT);
     config->enableStream(depthProfile);
 
-    // Create HdrMerge post processor to merge depth frames betweens different hdr sequence ids.
-    // The HdrMerge also supports processing of infrared frames.
-    ob::HdrMerge hdrMerge;
+    // Merge the depth frames of the two hdr sequence ids on the host: the merged frame is ready as soon as the second exposure
+    // arrives, and the output frames are reused once the window drops them. The ob::HdrMerge post processor of the SDK also
+    // supports infrared frames.
+    HostHdrMerge hdrMerge(defaultExecutor());
 
     // configure and enable Hdr stream
     OBHdrConfig obHdrConfig;
@@ -45,9 +48,17 @@ int main(int argc, char **argv) try {
     // Start the pipeline with config
     pipe.start(config);
 
+    // Route the depth frames of each exposure to its own callback without copying them, they are shown side by side when the
+    // merge is disabled
+    SequenceDemux              demux;
+    std::shared_ptr<ob::Frame> exposureFrames[2];
+    for(uint32_t sequence = 0; sequence < 2; sequence++) {
+        demux.route(sequence, [&exposureFrames, sequence](std::shared_ptr<ob::Frame> frame) { exposureFrames[sequence] = frame; });
+    }
+
     // Create a window for rendering and set the resolution of the window
     bool   resizeWindows = true;
-    Window app("HDR-Merge", 1280, 720);
+    Window app("HDR-Merge", 1280, 720, RENDER_ONE_ROW);
     bool   mergeRequired = true;
 
     std::cout << "Press 'M' to toggle HDR merge." << std::endl;
@@ -55,6 +66,7 @@ int main(int argc, char **argv) try {
         auto key = app.waitKey(10);
         if(key == 'M' || key == 'm') {
             mergeRequired = !mergeRequired;
+            hdrMerge.reset();
             if(mergeRequired) {
                 std::cout << "HDR merge enabled." << std::endl;
             }
@@ -73,6 +85,7 @@ int main(int argc, char **argv) try {
             continue;
         }
 
+        demux.dispatch(depthFrame);
         if(mergeRequired) {
             // Using HdrMerge post processor to merge depth frames
             auto mergedDepthFrame = hdrMerge.process(depthFrame);
@@ -84,14 +97,26 @@ int main(int argc, char **argv) try {
             app.addToRender(mergedDepthFrame);
         }
         else {
-            // add original depth frame to render queue
-            app.addToRender(depthFrame);
+            // add the last depth frame of each exposure to render queue
+            if(exposureFrames[0] && exposureFrames[1]) {
+                app.addToRender({ exposureFrames[0], exposureFrames[1] });
+            }
+            else {
+                app.addToRender(depthFrame);
+            }
         }
     }
 
     // Stop the Pipeline, no frame data will be generated
     pipe.stop();
 
+    auto stats = hdrMerge.stats();
+    std::cout << "HDR merge: merged " << stats.merged << ", unpaired " << stats.unpaired << ", without sequence index " << stats.passedThrough
+              << ", output frames allocated " << stats.framesAllocated << std::endl;
+    for(auto &sequenceStats: demux.stats()) {
+        std::cout << "Sequence " << sequenceStats.sequence << ": " << sequenceStats.frames << " frames, " << sequenceStats.frameRate << " fps" << std::endl;
+    }
+
     // close hdr merge
     obHdrConfig.enable = false;
     device->setStructuredData(OB_STRUCT_DEPTH_HDR_CONFIG, &obHdrConfig, sizeof(OBHdrConfig));
@@ -1,5 +1,6 @@
 #include "libobsensor/ObSensor.hpp"
 #include "utils.hpp"
+#include "device_registry.hpp"
 #include <iostream>
 #include <thread>
 #include <map>
@@ -37,6 +38,7 @@ std::ostream &operator<<(std::ostream &os, std::shared_ptr<ob::VideoFrame> frame
 void handleDeviceConnected(std::shared_ptr<ob::DeviceList> connectList);
 void handleDeviceDisconnected(std::shared_ptr<ob::DeviceList> disconnectList);
 void rebootDevices();
+void printDevices(const DeviceRegistry &registry);
 void startStream(std::shared_ptr<PipelineHolder> holder);
 void stopStream(std::shared_ptr<PipelineHolder> holder);
 
@@ -45,14 +47,18 @@ int main(int argc, char **argv) try {
     // create context
     ob::Context ctx;
 
+    // the registry keeps the connected device list up to date from the device changed events, listing the devices does not
+    // enumerate them again
+    DeviceRegistry registry(ctx);
+
     // register device callback
-    ctx.setDeviceChangedCallback([](std::shared_ptr<ob::DeviceList> removedList, std::shared_ptr<ob::DeviceList> addedList) {
+    registry.setDeviceChangedCallback([](std::shared_ptr<ob::DeviceList> removedList, std::shared_ptr<ob::DeviceList> addedList) {
         handleDeviceDisconnected(removedList);
         handleDeviceConnected(addedList);
     });
 
     // handle current connected devices.
-    handleDeviceConnected(ctx.queryDeviceList());
+    handleDeviceConnected(registry.refresh());
 
     while(true) {
         if(kbhit()) {
@@ -67,6 +73,11 @@ int main(int argc, char **argv) try {
             if(key == 'r' || key == 'R') {
                 rebootDevices();
             }
+
+            // Press the l key to list the connected devices
+            if(key == 'l' || key == 'L') {
+                printDevices(registry);
+            }
         }
         else {
             std::this_thread::sleep_for(std::chrono::milliseconds(500));
@@ -149,6 +160,18 @@ void rebootDevices() {
     }
 }
 
+void printDevices(const DeviceRegistry &registry) {
+    auto devices = registry.devices();
+    std::cout << "Connected devices, count: " << devices.size() << std::endl;
+    for(auto &device: devices) {
+        std::cout << "    sn: " << device.serialNumber << ", uid: " << device.uid << ", connection: " << device.connectionType;
+        if(!device.ipAddress.empty()) {
+            std::cout << ", ip: " << device.ipAddress;
+        }
+        std::cout << std::endl;
+    }
+}
+
 void startStream(std::shared_ptr<PipelineHolder> holder) {
     std::shared_ptr<FramePrintInfo> printInfo(new FramePrintInfo{});
     std::string                     deviceSN = std::string(holder->deviceInfo->serialNumber());
@@ -1,7 +1,9 @@
 #include <iostream>
 #include <mutex>
+#include <string>
 #include <libobsensor/ObSensor.hpp>
 #include "utils.hpp"
+#include "imu_batch.hpp"
 
 #define ESC 27
 std::mutex printerMutex;
@@ -20,6 +22,26 @@ int        main(int argc, char **argv) try {
         return -1;
     }
 
+    // ImuReader batch: the samples are queued by the sensor callbacks and delivered in batches of 100 samples or every 10 ms
+    bool           batchMode = argc > 1 && std::string(argv[1]) == "batch";
+    ImuBatchReader imuBatchReader;
+    uint64_t       batchSamples = 0;
+    if(batchMode) {
+        imuBatchReader.startBatches(
+            [&batchSamples](const ImuSample *samples, size_t count) {
+                std::unique_lock<std::mutex> lk(printerMutex);
+                uint64_t                     previous = batchSamples;
+                batchSamples += count;
+                if(batchSamples / 1000 != previous / 1000) {  // Reduce printing frequency
+                    const ImuSample &last = samples[count - 1];
+                    std::cout << "IMU batch of " << count << " samples, " << batchSamples << " samples received, last "
+                              << (last.type == OB_FRAME_ACCEL ? "accel" : "gyro") << " tsp = " << last.timestampUs << " us {" << last.x << ", "
+                              << last.y << ", " << last.z << "}" << std::endl;
+                }
+            },
+            100, std::chrono::milliseconds(10));
+    }
+
     // Create a device, 0 represents the index of the first device
     auto                        dev         = devList->getDevice(0);
     std::shared_ptr<ob::Sensor> gyroSensor  = nullptr;
@@ -32,7 +54,7 @@ int        main(int argc, char **argv) try {
             auto profiles = gyroSensor->getStreamProfileList();
             // Select the first profile to open stream
             auto profile = profiles->getProfile(OB_PROFILE_DEFAULT);
-            gyroSensor->start(profile, [](std::shared_ptr<ob::Frame> frame) {
+            ob::FrameCallback printGyro = [](std::shared_ptr<ob::Frame> frame) {
                 std::unique_lock<std::mutex> lk(printerMutex);
                 auto                         timeStamp = frame->timeStamp();
                 auto                         index     = frame->index();
@@ -50,7 +72,8 @@ int        main(int argc, char **argv) try {
                               << "\n\r"
                               << "}\n\r" << std::endl;
                 }
-            });
+            };
+            gyroSensor->start(profile, batchMode ? imuBatchReader.gyroCallback() : printGyro);
         }
         else {
             std::cout << "get gyro Sensor failed ! " << std::endl;
@@ -68,7 +91,7 @@ int        main(int argc, char **argv) try {
         auto profiles = accelSensor->getStreamProfileList();
         // Select the first profile to open stream
         auto profile = profiles->getProfile(OB_PROFILE_DEFAULT);
-        accelSensor->start(profile, [](std::shared_ptr<ob::Frame> frame) {
+        ob::FrameCallback printAccel = [](std::shared_ptr<ob::Frame> frame) {
             std::unique_lock<std::mutex> lk(printerMutex);
             auto                         timeStamp  = frame->timeStamp();
             auto                         index      = frame->index();
@@ -86,7 +109,8 @@ int        main(int argc, char **argv) try {
                           << "\n\r"
                           << "}\n\r" << std::endl;
             }
-        });
+        };
+        accelSensor->start(profile, batchMode ? imuBatchReader.accelCallback() : printAccel);
     }
     else {
         std::cout << "get Accel Sensor failed ! " << std::endl;
@@ -108,6 +132,11 @@ int        main(int argc, char **argv) try {
     if(accelSensor) {
         accelSensor->stop();
     }
+    if(batchMode) {
+        imuBatchReader.stopBatches();
+        std::cout << "IMU samples received " << imuBatchReader.receivedCount() << ", dropped " << imuBatchReader.droppedCount() << ", batches "
+                  << imuBatchReader.batchCount() << std::endl;
+    }
 
     return 0;
 }
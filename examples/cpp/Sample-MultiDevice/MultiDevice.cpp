@@ -3,9 +3,11 @@ Notes:
 on the Arm/Linux platform ,this sample requires users to compile with Opencv4.2 or above,otherwise, it cannot be rendered.
 */
 #include "window.hpp"
+#include "frame_memory_budget.hpp"
 
 #include "libobsensor/ObSensor.hpp"
 #include "libobsensor/hpp/Error.hpp"
+#include <cstdlib>
 #include <mutex>
 
 const int maxDeviceCount = 9;
@@ -16,10 +18,27 @@ std::shared_ptr<ob::Frame>              depthFrames[maxDeviceCount];
 std::shared_ptr<ob::Frame>              irFrames[maxDeviceCount];
 std::mutex                              frameMutex;
 
+// Frame memory held by the application for all devices, shared by all pipelines of the context
+FrameMemoryBudget frameBudget;
+
 void StartStream(std::vector<std::shared_ptr<ob::Pipeline>> pipes);
 void StopStream(std::vector<std::shared_ptr<ob::Pipeline>> pipes);
 
 int main(int argc, char **argv) try {
+    // Optional frame memory limit in MB, e.g. "OBMultiDevice 256" on boards with little memory
+    if(argc > 1) {
+        int limitMB = std::atoi(argv[1]);
+        if(limitMB <= 0) {
+            std::cerr << "Invalid frame memory limit: " << argv[1] << ", expected a number of MB greater than 0" << std::endl;
+            return EXIT_FAILURE;
+        }
+        frameBudget.setLimit(static_cast<uint64_t>(limitMB) * 1024 * 1024);
+    }
+    frameBudget.setBudgetExceededCallback([](uint64_t inUseBytes, uint64_t limitBytes, uint64_t droppedCount) {
+        std::cout << "Frame memory limit reached(" << inUseBytes / 1024 / 1024 << "MB / " << limitBytes / 1024 / 1024 << "MB), dropped frames: " << droppedCount
+                  << std::endl;
+    });
+
     // Create a Context
     ob::Context ctx;
 
@@ -72,6 +91,8 @@ int main(int argc, char **argv) try {
     frames.clear();
     StopStream(pipes);
 
+    std::cout << "Total frames dropped by the frame memory budget: " << frameBudget.droppedCount() << std::endl;
+
     return 0;
 }
 catch(ob::Error &e) {
@@ -107,13 +128,17 @@ void StartStream(std::vector<std::shared_ptr<ob::Pipeline>> pipes) {
         }
 
         // Start the pipeline and pass in the configuration
+        // Frames exceeding the frame memory budget are dropped, the last admitted frames keep being rendered
         pipe->start(config, [i](std::shared_ptr<ob::FrameSet> frameSet) {
+            auto colorFrame = frameBudget.admit(frameSet->colorFrame());
+            auto depthFrame = frameBudget.admit(frameSet->depthFrame());
+
             std::lock_guard<std::mutex> lock(frameMutex);
-            if(frameSet->colorFrame()) {
-                colorFrames[i] = frameSet->colorFrame();
+            if(colorFrame) {
+                colorFrames[i] = colorFrame;
             }
-            if(frameSet->depthFrame()) {
-                depthFrames[i] = frameSet->depthFrame();
+            if(depthFrame) {
+                depthFrames[i] = depthFrame;
             }
         });
         i++;
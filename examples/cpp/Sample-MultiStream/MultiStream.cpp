@@ -1,4 +1,5 @@
 #include "window.hpp"
+#include "frame_delivery.hpp"
 
 #include "libobsensor/hpp/Pipeline.hpp"
 #include "libobsensor/hpp/Error.hpp"
@@ -45,35 +46,50 @@ int main(int argc, char **argv) try {
         config->enableVideoStream(streamType);
     }
 
-    // Start the pipeline with config
+    // The frames are delivered on application threads instead of the SDK threads, the name, cores and priority of each
+    // thread are set in its DeliveryThreadConfig.
     std::mutex                                        frameMutex;
     std::map<OBFrameType, std::shared_ptr<ob::Frame>> frameMap;
-    pipe.start(config, [&](std::shared_ptr<ob::FrameSet> frameset) {
-        auto count = frameset->frameCount();
-        for(int i = 0; i < count; i++) {
-            auto                         frame = frameset->getFrame(i);
-            std::unique_lock<std::mutex> lk(frameMutex);
-            frameMap[frame->type()] = frame;
-        }
+    DeliveryThreadConfig                              videoThreadConfig;
+    videoThreadConfig.name = "ob-video";
+    // videoThreadConfig.cpus     = { 2 };  // pin the thread to core 2
+    // videoThreadConfig.priority = 50;     // SCHED_FIFO priority, requires CAP_SYS_NICE on Linux
+    auto videoThread = std::make_shared<FrameDeliveryThread>(videoThreadConfig, [&](std::shared_ptr<ob::Frame> frame) {
+        std::unique_lock<std::mutex> lk(frameMutex);
+        frameMap[frame->type()] = frame;
     });
+    if(!videoThread->configApplied()) {
+        std::cout << "Video delivery thread settings refused: " << videoThread->configError() << std::endl;
+    }
+
+    StreamDelivery videoDelivery;
+    for(auto frameType: { OB_FRAME_COLOR, OB_FRAME_DEPTH, OB_FRAME_IR, OB_FRAME_IR_LEFT, OB_FRAME_IR_RIGHT }) {
+        videoDelivery.route(frameType, videoThread);
+    }
+
+    // Start the pipeline with config
+    pipe.start(config, videoDelivery.frameSetCallback());
 
     // The IMU frame rate is much faster than the video, so it is advisable to use a separate pipeline to obtain IMU data.
     auto                                              dev         = pipe.getDevice();
     auto                                              imuPipeline = std::make_shared<ob::Pipeline>(dev);
     std::mutex                                        imuFrameMutex;
     std::map<OBFrameType, std::shared_ptr<ob::Frame>> imuFrameMap;
+    DeliveryThreadConfig                              imuThreadConfig;
+    imuThreadConfig.name      = "ob-imu";
+    imuThreadConfig.queueSize = 64;
+    auto imuThread            = std::make_shared<FrameDeliveryThread>(imuThreadConfig, [&](std::shared_ptr<ob::Frame> frame) {
+        std::unique_lock<std::mutex> lk(imuFrameMutex);
+        imuFrameMap[frame->type()] = frame;
+    });
+    StreamDelivery imuDelivery;
+    imuDelivery.route(OB_FRAME_GYRO, imuThread);
+    imuDelivery.route(OB_FRAME_ACCEL, imuThread);
     try {
         std::shared_ptr<ob::Config> imuConfig = std::make_shared<ob::Config>();
         imuConfig->enableGyroStream();
         imuConfig->enableAccelStream();
-        imuPipeline->start(imuConfig, [&](std::shared_ptr<ob::FrameSet> frameset) {
-            auto count = frameset->frameCount();
-            for(int i = 0; i < count; i++) {
-                auto                         frame = frameset->getFrame(i);
-                std::unique_lock<std::mutex> lk(imuFrameMutex);
-                imuFrameMap[frame->type()] = frame;
-            }
-        });
+        imuPipeline->start(imuConfig, imuDelivery.frameSetCallback());
     }
     catch(...) {
         std::cout << "IMU sensor not found!" << std::endl;
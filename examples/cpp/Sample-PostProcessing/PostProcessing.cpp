@@ -1,8 +1,19 @@
 #include "window.hpp"
+#include "filter_graph.hpp"
+#include "temporal_filter.hpp"
+#include "hole_filling_filter.hpp"
+#include "noise_removal_filter.hpp"
+#include "decimation_filter.hpp"
+#include "disparity_transform.hpp"
 
 #include "libobsensor/hpp/Pipeline.hpp"
 #include "libobsensor/hpp/Error.hpp"
 
+#include <cstdlib>
+#include <mutex>
+#include <utility>
+#include <vector>
+
 int main(int argc, char **argv) try {
     // Create a pipeline with default device
     ob::Pipeline pipe;
@@ -28,21 +39,162 @@ int main(int argc, char **argv) try {
     auto obFilterList = pipe.getDevice()->getSensor(OB_SENSOR_DEPTH)->getRecommendedFilters();
 
     std::shared_ptr<ob::DecimationFilter> decFilter;
+    std::shared_ptr<ob::ThresholdFilter>  thresholdFilter;
     for(int i = 0; i < obFilterList->count(); i++) {
         auto filter =obFilterList->getFilter(i);
         std::cout << "Depth recommended post processor filter type: " << filter->type() << std::endl;
         if(filter->is<ob::DecimationFilter>()) {
             decFilter = filter->as<ob::DecimationFilter>();
         }
+        if(filter->is<ob::ThresholdFilter>() && filter->isEnabled()) {
+            thresholdFilter = filter->as<ob::ThresholdFilter>();
+        }
+    }
+
+    // Run the filters on the application executor instead of threads created by the SDK, the application thread pool can be
+    // installed here with setDefaultExecutor()
+    auto executor = defaultExecutor();
+    std::cout << "Filter executor parallelism: " << executor->parallelism() << std::endl;
+
+    // Chain the enabled filters in a graph, the filters work on successive frames at the same time on the executor.
+    // The noise removal, temporal and hole filling filters run on the host, split in bands over the executor. They take the
+    // settings of the recommended SDK filters, the temporal persistence and the hole filling radius below are host additions.
+    std::mutex                      processedMutex;
+    std::shared_ptr<ob::DepthFrame> processedFrame;
+    HostTemporalFilter              temporalFilter(executor);
+    HostHoleFillingFilter           holeFillingFilter(executor);
+    HostNoiseRemovalFilter          noiseRemovalFilter(executor);
+    HostDecimationFilter            decimationFilter(executor);
+    FilterGraph                     filterGraph(executor);
+    // The host filters added after the decimation stage receive frames decimated by its scale
+    uint32_t                                        frameScale = 1;
+    std::vector<std::pair<DepthFilter *, uint32_t>> roiFilters;
+    auto                                            addHostStage = [&](std::shared_ptr<ob::Filter> filter) {
+        if(filter->is<ob::NoiseRemovalFilter>()) {
+            noiseRemovalFilter.setFilterParams(filter->as<ob::NoiseRemovalFilter>()->getFilterParams());
+            roiFilters.push_back(std::make_pair(&noiseRemovalFilter, frameScale));
+            filterGraph.addStage(noiseRemovalFilter.type(), [&noiseRemovalFilter](std::shared_ptr<ob::Frame> frame) { return noiseRemovalFilter.process(frame); });
+        }
+        else if(filter->is<ob::TemporalFilter>()) {
+            auto sdkTemporalFilter = filter->as<ob::TemporalFilter>();
+            temporalFilter.setDiffScale(sdkTemporalFilter->getDiffScaleRange().cur);
+            temporalFilter.setWeight(sdkTemporalFilter->getWeightRange().cur);
+            // Keep the depth of the pixels that were valid in 2 of the last 3 frames
+            temporalFilter.setPersistence(2, 3);
+            roiFilters.push_back(std::make_pair(&temporalFilter, frameScale));
+            filterGraph.addStage(temporalFilter.type(), [&temporalFilter](std::shared_ptr<ob::Frame> frame) { return temporalFilter.process(frame); });
+        }
+        else if(filter->is<ob::HoleFillingFilter>()) {
+            // Holes wider than 2 * 8 pixels stay invalid, the cost per frame does not depend on the holes
+            holeFillingFilter.setFilterMode(filter->as<ob::HoleFillingFilter>()->getFilterMode());
+            holeFillingFilter.setMaxRadius(8);
+            roiFilters.push_back(std::make_pair(&holeFillingFilter, frameScale));
+            filterGraph.addStage(holeFillingFilter.type(), [&holeFillingFilter](std::shared_ptr<ob::Frame> frame) { return holeFillingFilter.process(frame); });
+        }
+        else if(filter->is<ob::DecimationFilter>()) {
+            // The depth range of an enabled threshold filter is applied in the same pass, over the full resolution frame
+            decimationFilter.setScaleValue(filter->as<ob::DecimationFilter>()->getScaleValue());
+            if(thresholdFilter) {
+                decimationFilter.setThreshold(static_cast<uint16_t>(thresholdFilter->getMinRange().cur),
+                                              static_cast<uint16_t>(thresholdFilter->getMaxRange().cur));
+            }
+            filterGraph.addStage(decimationFilter.type(), [&decimationFilter](std::shared_ptr<ob::Frame> frame) { return decimationFilter.process(frame); });
+            frameScale *= decimationFilter.getScaleValue();
+        }
+    };
+
+    // The SDK filters listed between the two disparity transforms (the spatial filters) work on disparity. The transforms run
+    // on the host by table lookup, calibrated with the depth focal length and the baseline; without calibration the SDK
+    // transforms are kept. The host filters work on depth, the ones listed between the transforms run right after the
+    // conversion back to depth.
+    HostDisparityTransform depthToDisparity(true, executor);
+    HostDisparityTransform disparityToDepth(false, executor);
+    auto                   device = pipe.getDevice();
+    if(device->isPropertySupported(OB_STRUCT_BASELINE_CALIBRATION_PARAM, OB_PERMISSION_READ)) {
+        OBBaselineCalibrationParam baselineParam;
+        uint32_t                   size        = sizeof(baselineParam);
+        auto                       calibration = pipe.getCalibrationParam(config);
+        device->getStructuredData(OB_STRUCT_BASELINE_CALIBRATION_PARAM, &baselineParam, &size);
+        depthToDisparity.setCalibration(calibration.intrinsics[OB_SENSOR_DEPTH].fx, baselineParam.baseline);
+        disparityToDepth.setCalibration(calibration.intrinsics[OB_SENSOR_DEPTH].fx, baselineParam.baseline);
+    }
+    bool                                     hostDisparity = depthToDisparity.table() != nullptr;
+    // The noise removal compares the disparities of the neighbors as the SDK filter does, looked up in the table of the
+    // transform; without calibration the SDK filter is kept
+    noiseRemovalFilter.setDisparityTable(depthToDisparity.table());
+    bool                                     inDisparity   = false;
+    std::vector<std::shared_ptr<ob::Filter>> depthStages;  // host filters waiting for the conversion back to depth
+    auto                                     leaveDisparity = [&]() {
+        filterGraph.addStage(disparityToDepth.type(), [&disparityToDepth](std::shared_ptr<ob::Frame> frame) { return disparityToDepth.process(frame); });
+        inDisparity = false;
+        for(auto &filter: depthStages) {
+            addHostStage(filter);
+        }
+        depthStages.clear();
+    };
+
+    for(int i = 0; i < obFilterList->count(); i++) {
+        auto filter = obFilterList->getFilter(i);
+        if(!filter->isEnabled()) {
+            continue;
+        }
+        if(filter->is<ob::ThresholdFilter>() && decFilter && decFilter->isEnabled()) {
+            continue;
+        }
+        if(filter->is<ob::DisparityTransform>() && hostDisparity) {
+            // The recommended list converts to disparity before the spatial filters and back to depth after them
+            if(!inDisparity) {
+                filterGraph.addStage(depthToDisparity.type(), [&depthToDisparity](std::shared_ptr<ob::Frame> frame) { return depthToDisparity.process(frame); });
+                inDisparity = true;
+            }
+            else {
+                leaveDisparity();
+            }
+            continue;
+        }
+        if((filter->is<ob::NoiseRemovalFilter>() && hostDisparity) || filter->is<ob::TemporalFilter>() || filter->is<ob::HoleFillingFilter>()
+           || filter->is<ob::DecimationFilter>()) {
+            if(inDisparity) {
+                depthStages.push_back(filter);
+            }
+            else {
+                addHostStage(filter);
+            }
+            continue;
+        }
+        filterGraph.addFilter(filter);
+    }
+    if(inDisparity) {
+        leaveDisparity();
     }
 
+    // PostProcessing x y width height: the host filters only compute the region of interest and pass the rest through. The
+    // region is given in full resolution pixels, the filters after the decimation get the decimated pixels covering it.
+    if(argc == 5) {
+        OBRect roi = { static_cast<uint32_t>(atoi(argv[1])), static_cast<uint32_t>(atoi(argv[2])), static_cast<uint32_t>(atoi(argv[3])),
+                       static_cast<uint32_t>(atoi(argv[4])) };
+        for(auto &entry: roiFilters) {
+            uint32_t scale  = entry.second;
+            OBRect   scaled = { roi.x / scale, roi.y / scale, (roi.x + roi.width + scale - 1) / scale - roi.x / scale,
+                              (roi.y + roi.height + scale - 1) / scale - roi.y / scale };
+            entry.first->setRoi(scaled);
+            std::cout << entry.first->type() << " region of interest: " << scaled.x << "," << scaled.y << " " << scaled.width << "x" << scaled.height
+                      << std::endl;
+        }
+    }
+    filterGraph.setCallBack([&](std::shared_ptr<ob::Frame> frame) {
+        std::lock_guard<std::mutex> lock(processedMutex);
+        processedFrame = frame->as<ob::DepthFrame>();
+    });
+
     // Start the pipeline with config
     pipe.start(config);
 
     // Create a window for rendering, and set the resolution of the window
     Window app("PostProcessing", depthProfile->width(), depthProfile->height());
 
-    bool resizeWindow = false;
+    float depthUnit    = 0;
+    bool  resizeWindow = false;
     if(decFilter && decFilter->isEnabled()) {
         resizeWindow = true;
     }
@@ -54,21 +206,35 @@ int main(int argc, char **argv) try {
         }
 
         auto depthFrame = frameSet->depthFrame();
-        if(depthFrame) {
-            for(int i = 0; i < obFilterList->count(); i++) {
-                auto filter = obFilterList->getFilter(i);
-                if(filter->isEnabled()) {
-                    auto newFrame = filter->process(depthFrame);
-                    depthFrame    = newFrame->as<ob::DepthFrame>();
-                }
-            }
+        if(depthFrame == nullptr) {
+            continue;
+        }
+
+        // The frames created by the host filters do not carry the value scale and index of the stream
+        float    scale = depthFrame->getValueScale();
+        uint64_t index = depthFrame->index();
+        if(scale > 0 && scale != depthUnit) {
+            // The frames without value scale are read, and the depth converted back from disparity is written, in the unit of
+            // the stream
+            depthUnit = scale;
+            depthToDisparity.setDepthUnit(depthUnit);
+            disparityToDepth.setDepthUnit(depthUnit);
+            noiseRemovalFilter.setDisparityTable(depthToDisparity.table());
+        }
+        if(filterGraph.stageCount() > 0) {
+            // The processed frame is rendered when it is ready, the main thread does not wait for the filters
+            filterGraph.pushFrame(depthFrame);
+            std::lock_guard<std::mutex> lock(processedMutex);
+            depthFrame = processedFrame;
+        }
+        if(depthFrame == nullptr) {
+            continue;
         }
 
         // for Y16 format depth frame, print the distance of the center pixel every 30 frames
-        if(depthFrame->index() % 30 == 0 && depthFrame->format() == OB_FORMAT_Y16) {
+        if(index % 30 == 0 && depthFrame->format() == OB_FORMAT_Y16) {
             uint32_t  width  = depthFrame->width();
             uint32_t  height = depthFrame->height();
-            float     scale  = depthFrame->getValueScale();
             uint16_t *data   = (uint16_t *)depthFrame->data();
 
             // pixel value multiplied by scale is the actual distance value in millimeters
@@ -76,6 +242,12 @@ int main(int argc, char **argv) try {
 
             // attention: if the distance is 0, it means that the depth camera cannot detect the object（may be out of detection range）
             std::cout << "Facing an object " << centerDistance << " mm away. " << std::endl;
+
+            // Disparity of the center pixel, by lookup in the table of the depth to disparity transform
+            uint16_t disparity = 0;
+            if(depthToDisparity.transform(&data[width * height / 2 + width / 2], 1, &disparity, scale)) {
+                std::cout << "Disparity " << disparity / static_cast<float>(1u << depthToDisparity.fractionBits()) << " pixels" << std::endl;
+            }
         }
 
         if(resizeWindow) {
@@ -90,6 +262,13 @@ int main(int argc, char **argv) try {
     // Stop the pipeline
     pipe.stop();
 
+    // The graph callback uses the local variables, wait for the frames in flight
+    filterGraph.flush();
+    for(auto &stats: filterGraph.stats()) {
+        std::cout << "Filter " << stats.name << ": processed " << stats.processed << ", dropped " << stats.dropped << ", max queue depth "
+                  << stats.maxQueueDepth << ", average " << stats.avgProcessMs << " ms, queue wait " << stats.avgWaitMs << " ms" << std::endl;
+    }
+
     return 0;
 }
 catch(ob::Error &e) {
@@ -1,15 +1,21 @@
 #include "libobsensor/ObSensor.hpp"
 #include "utils.hpp"
+#include "startup_timer.hpp"
 #include <chrono>
 #include <iostream>
 #define ESC 27
 
 int main(int argc, char **argv) try {
 
+    // Measure the time to the first frame
+    StartupTimer startupTimer;
+
     // Create a pipeline with default device
     ob::Pipeline pipe;
+    startupTimer.mark("create pipeline");
     // Start the pipeline with default config, more info please refer to the `misc/config/OrbbecSDKConfig_v1.0.xml`
     pipe.start();
+    startupTimer.mark("start pipeline");
 
     auto lastTime = std::chrono::high_resolution_clock::now();
 
@@ -22,6 +28,9 @@ int main(int argc, char **argv) try {
         if(!frameSet) {
             continue;
         }
+        if(startupTimer.mark("first frame")) {
+            startupTimer.report(std::cout);
+        }
         auto colorFrame = frameSet->colorFrame();
         auto depthFrame = frameSet->depthFrame();
         auto now        = std::chrono::high_resolution_clock::now();
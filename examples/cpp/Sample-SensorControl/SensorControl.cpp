@@ -8,13 +8,16 @@
 #include <sstream>
 #include "libobsensor/ObSensor.hpp"
 #include "libobsensor/hpp/Error.hpp"
+#include "property_batch.hpp"
+#include "property_cache.hpp"
 
 std::shared_ptr<ob::Device> selectDevice(std::shared_ptr<ob::DeviceList> deviceList);
-std::vector<OBPropertyItem> getPropertyList(std::shared_ptr<ob::Device> device);
+std::vector<OBPropertyItem> getPropertyList(PropertyCache &propertyCache);
 bool                        isPrimaryTypeProperty(OBPropertyItem propertyItem);
-void                        printfPropertyList(std::shared_ptr<ob::Device> device, const std::vector<OBPropertyItem> &propertyList);
-void                        setPropertyValue(std::shared_ptr<ob::Device> device, OBPropertyItem item, std::string strValue);
+void                        printfPropertyList(PropertyCache &propertyCache, const std::vector<OBPropertyItem> &propertyList);
+void                        setPropertyValue(PropertyCache &propertyCache, OBPropertyItem item, std::string strValue);
 void                        getPropertyValue(std::shared_ptr<ob::Device> device, OBPropertyItem item);
+void                        getAllPropertyValues(std::shared_ptr<ob::Device> device);
 std::string                 permissionTypeToString(OBPermissionType permission);
 
 int main(int argc, char **argv) try {
@@ -48,6 +51,9 @@ int main(int argc, char **argv) try {
             break;
         }
 
+        // The property table and ranges are static, cache them on the host instead of querying the device on every listing
+        PropertyCache propertyCache(device);
+
         std::cout << "Input \"?\" to get all properties." << std::endl;
         std::vector<OBPropertyItem> propertyList;
         bool                        isSelectProperty = true;
@@ -73,10 +79,16 @@ int main(int argc, char **argv) try {
                     break;
                 }
 
+                // read all properties with one batch
+                if(controlVec.size() == 2 && controlVec.at(0) == "all" && controlVec.at(1) == "get") {
+                    getAllPropertyValues(device);
+                    continue;
+                }
+
                 // Check if it matches the input format
                 if(controlVec.size() <= 1 || (controlVec.at(1) != "get" && controlVec.at(1) != "set") || controlVec.size() > 3
                    || (controlVec.at(1) == "set" && controlVec.size() < 3)) {
-                    std::cout << "Property control usage: [property index] [set] [property value] or [property index] [get]" << std::endl;
+                    std::cout << "Property control usage: [property index] [set] [property value] or [property index] [get] or [all] [get]" << std::endl;
                     continue;
                 }
                 int size     = propertyList.size();
@@ -95,12 +107,12 @@ int main(int argc, char **argv) try {
                 }
                 else {
                     // set property value
-                    setPropertyValue(device, propertyItem, controlVec.at(2));
+                    setPropertyValue(propertyCache, propertyItem, controlVec.at(2));
                 }
             }
             else {
-                propertyList = getPropertyList(device);
-                printfPropertyList(device, propertyList);
+                propertyList = getPropertyList(propertyCache);
+                printfPropertyList(propertyCache, propertyList);
                 std::cout << "Please select property.(Property control usage: [property number] [set/get] [property value])" << std::endl;
             }
         }
@@ -136,7 +148,7 @@ std::shared_ptr<ob::Device> selectDevice(std::shared_ptr<ob::DeviceList> deviceL
 }
 
 // Print a list of supported properties
-void printfPropertyList(std::shared_ptr<ob::Device> device, const std::vector<OBPropertyItem> &propertyList) {
+void printfPropertyList(PropertyCache &propertyCache, const std::vector<OBPropertyItem> &propertyList) {
     std::cout << "size: " << propertyList.size() << std::endl;
     if(propertyList.empty()) {
         std::cout << "No supported property!" << std::endl;
@@ -154,7 +166,7 @@ void printfPropertyList(std::shared_ptr<ob::Device> device, const std::vector<OB
             break;
         case OB_INT_PROPERTY: {
             try {
-                int_range = device->getIntPropertyRange(property_item.id);
+                int_range = propertyCache.getIntPropertyLimits(property_item.id);
                 strRange  = "Int value(min:" + std::to_string(int_range.min) + ", max:" + std::to_string(int_range.max)
                            + ", step:" + std::to_string(int_range.step) + ")";
             }
@@ -164,7 +176,7 @@ void printfPropertyList(std::shared_ptr<ob::Device> device, const std::vector<OB
         } break;
         case OB_FLOAT_PROPERTY:
             try {
-                float_range = device->getFloatPropertyRange(property_item.id);
+                float_range = propertyCache.getFloatPropertyLimits(property_item.id);
                 strRange    = "Float value(min:" + std::to_string(float_range.min) + ", max:" + std::to_string(float_range.max)
                            + ", step:" + std::to_string(float_range.step) + ")";
             }
@@ -184,6 +196,7 @@ void printfPropertyList(std::shared_ptr<ob::Device> device, const std::vector<OB
         std::cout << ", permission=" << permissionTypeToString(property_item.permission) << ", range=" << strRange << std::endl;
     }
     std::cout << "------------------------------------------------------------------------\n";
+    std::cout << "property cache hit: " << propertyCache.hitCount() << ", miss: " << propertyCache.missCount() << std::endl;
 }
 
 bool isPrimaryTypeProperty(OBPropertyItem propertyItem) {
@@ -191,12 +204,12 @@ bool isPrimaryTypeProperty(OBPropertyItem propertyItem) {
 }
 
 // Get property list
-std::vector<OBPropertyItem> getPropertyList(std::shared_ptr<ob::Device> device) {
+std::vector<OBPropertyItem> getPropertyList(PropertyCache &propertyCache) {
     std::vector<OBPropertyItem> propertyVec;
     propertyVec.clear();
-    uint32_t size = device->getSupportedPropertyCount();
+    uint32_t size = propertyCache.getSupportedPropertyCount();
     for(uint32_t i = 0; i < size; i++) {
-        OBPropertyItem property_item = device->getSupportedProperty(i);
+        OBPropertyItem property_item = propertyCache.getSupportedProperty(i);
         if(isPrimaryTypeProperty(property_item) && property_item.permission != OB_PERMISSION_DENY) {
             propertyVec.push_back(property_item);
         }
@@ -205,7 +218,7 @@ std::vector<OBPropertyItem> getPropertyList(std::shared_ptr<ob::Device> device)
 }
 
 // set properties
-void setPropertyValue(std::shared_ptr<ob::Device> device, OBPropertyItem propertyItem, std::string strValue) {
+void setPropertyValue(PropertyCache &propertyCache, OBPropertyItem propertyItem, std::string strValue) {
     try {
         int   int_value   = 0;
         float float_value = 0.0f;
@@ -214,7 +227,7 @@ void setPropertyValue(std::shared_ptr<ob::Device> device, OBPropertyItem propert
         case OB_BOOL_PROPERTY:
             bool_value = std::atoi(strValue.c_str());
             try {
-                device->setBoolProperty(propertyItem.id, bool_value);
+                propertyCache.setBoolProperty(propertyItem.id, bool_value);
             }
             catch(...) {
                 std::cout << "set bool property fail." << std::endl;
@@ -224,7 +237,7 @@ void setPropertyValue(std::shared_ptr<ob::Device> device, OBPropertyItem propert
         case OB_INT_PROPERTY:
             int_value = std::atoi(strValue.c_str());
             try {
-                device->setIntProperty(propertyItem.id, int_value);
+                propertyCache.setIntProperty(propertyItem.id, int_value);
             }
             catch(...) {
                 std::cout << "set int property fail." << std::endl;
@@ -234,7 +247,7 @@ void setPropertyValue(std::shared_ptr<ob::Device> device, OBPropertyItem propert
         case OB_FLOAT_PROPERTY:
             float_value = std::atoi(strValue.c_str());
             try {
-                device->setFloatProperty(propertyItem.id, float_value);
+                propertyCache.setFloatProperty(propertyItem.id, float_value);
             }
             catch(...) {
                 std::cout << "set float property fail." << std::endl;
@@ -294,6 +307,33 @@ void getPropertyValue(std::shared_ptr<ob::Device> device, OBPropertyItem propert
     }
 }
 
+// get all readable property values with one batch
+void getAllPropertyValues(std::shared_ptr<ob::Device> device) {
+    auto results = readAllProperties(device);
+    for(auto &result: results) {
+        std::cout << "property id:" << (int)result.value.id;
+        if(result.status != OB_STATUS_OK) {
+            std::cout << ", get value failed: " << result.message << std::endl;
+            continue;
+        }
+
+        switch(result.value.type) {
+        case OB_BOOL_PROPERTY:
+            std::cout << ", bool value:" << result.value.boolValue << std::endl;
+            break;
+        case OB_INT_PROPERTY:
+            std::cout << ", int value:" << result.value.intValue << std::endl;
+            break;
+        case OB_FLOAT_PROPERTY:
+            std::cout << ", float value:" << result.value.floatValue << std::endl;
+            break;
+        default:
+            std::cout << std::endl;
+            break;
+        }
+    }
+}
+
 std::string permissionTypeToString(OBPermissionType permission) {
     switch(permission) {
     case OB_PERMISSION_READ:
@@ -6,10 +6,18 @@ using namespace std;
 #include <libobsensor/hpp/Utils.hpp>
 using namespace ob;
 
+#include "host_align.hpp"
+#include "xy_tables.hpp"
+
 const std::map<std::string, uint16_t> gemini_330_list = { { "gemini335", 0x0800 },  { "Gemini330", 0x0801 },   { "gemini336", 0x0803 },
                                                           { "gemini335L", 0x0804 }, { "Gemini 330L", 0x0805 }, { "gemini336L", 0x0807 },
                                                           { "Gemini335Lg", 0x080B } };
 
+// Shared memory segment of the xy tables of a sensor, the processes using the device map the tables of the first one
+std::string xyTablesName(std::shared_ptr<ob::Device> device, const OBCalibrationParam &param, OBSensorType sensor) {
+    return XYTablesCache::sharedName(device->getDeviceInfo()->serialNumber(), param, sensor);
+}
+
 bool IsGemini330Series(uint16_t pid) {
     bool find = false;
     for(auto it = gemini_330_list.begin(); it != gemini_330_list.end(); ++it) {
@@ -108,10 +116,9 @@ int depthPointCloudTransformation(std::shared_ptr<ob::Device> device, int case_n
     uint32_t pointcloudSize = depthWidth * depthHeight * sizeof(OBPoint3f);
     uint8_t *pointcloudData = new uint8_t[pointcloudSize];
 
-    uint32_t   tableSize = depthWidth * depthHeight * 2;
-    float     *data      = new float[tableSize];
-    OBXYTables xyTables;
-    if(!ob::CoordinateTransformHelper::transformationInitXYTables(param, OB_SENSOR_DEPTH, data, &tableSize, &xyTables)) {
+    // Computed once and shared with the other processes through shared memory
+    auto xyTables = xyTablesCache().getShared(xyTablesName(device, param, OB_SENSOR_DEPTH), param, OB_SENSOR_DEPTH);
+    if(!xyTables) {
         return -1;
     }
 
@@ -198,7 +205,7 @@ int depthPointCloudTransformation(std::shared_ptr<ob::Device> device, int case_n
                 OBPoint *pointPixel = (OBPoint *)pointcloudData;
                 auto     depthFrame = frameset->depthFrame();
 
-                ob::CoordinateTransformHelper::transformationDepthToPointCloud(&xyTables, depthFrame->data(), pointPixel);
+                ob::CoordinateTransformHelper::transformationDepthToPointCloud(xyTables->get(), depthFrame->data(), pointPixel);
                 savePointsDataToPly((uint8_t *)pointcloudData, pointcloudSize, "DepthPointsWithTables.ply");
                 std::cout << "DepthPointsWithTables.ply Saved" << std::endl;
                 break;
@@ -208,11 +215,6 @@ int depthPointCloudTransformation(std::shared_ptr<ob::Device> device, int case_n
     // stop the pipeline
     pipeline->stop();
 
-    if(data) {
-        delete[] data;
-        data = nullptr;
-    }
-
     if(pointcloudData) {
         delete[] pointcloudData;
         pointcloudData = nullptr;
@@ -306,14 +308,12 @@ int RGBPointCloudTransformation(std::shared_ptr<ob::Device> device) {
     auto     param       = pipeline->getCalibrationParam(config);
     uint32_t colorWidth  = colorProfile->width();
     uint32_t colorHeight = colorProfile->height();
-    uint32_t tableSize   = colorWidth * colorHeight * 2;
-    float   *data        = new float[tableSize];
 
     uint32_t pointcloudSize = colorWidth * colorHeight * sizeof(OBColorPoint);
     uint8_t *pointcloudData = new uint8_t[pointcloudSize];
 
-    OBXYTables xyTables;
-    if(!ob::CoordinateTransformHelper::transformationInitXYTables(param, OB_SENSOR_COLOR, data, &tableSize, &xyTables)) {
+    auto xyTables = xyTablesCache().getShared(xyTablesName(device, param, OB_SENSOR_COLOR), param, OB_SENSOR_COLOR);
+    if(!xyTables) {
         return -1;
     }
 
@@ -332,7 +332,7 @@ int RGBPointCloudTransformation(std::shared_ptr<ob::Device> device) {
             uint32_t depthWidth = depthFrame->width();
             uint32_t colorWidth = colorFrame->width();
 
-            ob::CoordinateTransformHelper::transformationDepthToRGBDPointCloud(&xyTables, depthFrame->data(), colorFrame->data(), pointPixel);
+            ob::CoordinateTransformHelper::transformationDepthToRGBDPointCloud(xyTables->get(), depthFrame->data(), colorFrame->data(), pointPixel);
 
             saveRGBDPointsDataToPly((uint8_t *)pointcloudData, pointcloudSize, "RGBDDepthPointsWithTables.ply");
             std::cout << "RGBDDepthPointsWithTables.ply Saved" << std::endl;
@@ -348,11 +348,6 @@ int RGBPointCloudTransformation(std::shared_ptr<ob::Device> device) {
     // stop the pipeline
     pipeline->stop();
 
-    if(data) {
-        delete[] data;
-        data = nullptr;
-    }
-
     if(pointcloudData) {
         delete[] pointcloudData;
         pointcloudData = nullptr;
@@ -519,6 +514,8 @@ int color2DToDepth2DTransformation(std::shared_ptr<ob::Device> device) {
     OBStreamType align_to_stream = OB_STREAM_COLOR;
     ob::Align    align(align_to_stream);
     int          count = 0;
+    // Depth to color transformation on the host, the transformer keeps its tables and output buffer across frames
+    std::shared_ptr<DepthToColorTransformer> transformer;
     // Limit up to 10 repetitions
     while(count++ < 20) {
         // Wait for a frame of data, the timeout is 100ms
@@ -535,7 +532,7 @@ int color2DToDepth2DTransformation(std::shared_ptr<ob::Device> device) {
             uint32_t                        colorHeight   = colorFrame->height();
             auto                            deviceInfo    = device->getDeviceInfo();
             auto                            pid           = deviceInfo->pid();
-            uint16_t                       *depthAfterD2C = nullptr;
+            const uint16_t                 *depthAfterD2C = nullptr;
             float                           valueScale    = 1;
             std::shared_ptr<ob::DepthFrame> depthD2CFrame = nullptr;
             // Because of the conversion from Color 2D to Depth 2D, the Depth values of Color points are required, so D2C conversion is needed
@@ -546,22 +543,23 @@ int color2DToDepth2DTransformation(std::shared_ptr<ob::Device> device) {
                 }
                 auto newFrameSet = newFrame->as<ob::FrameSet>();
                 depthD2CFrame    = newFrameSet->depthFrame();
+                if(depthD2CFrame == nullptr) {
+                    continue;
+                }
+                valueScale    = depthD2CFrame->getValueScale();
+                depthAfterD2C = (const uint16_t *)depthD2CFrame->data();
             }
             else {
-                auto frame = ob::CoordinateTransformHelper::transformationDepthFrameToColorCamera(device, depthFrame, colorWidth, colorHeight);
-                if(frame == nullptr) {
+                if(!transformer || transformer->width() != colorWidth || transformer->height() != colorHeight) {
+                    transformer = std::make_shared<DepthToColorTransformer>(param, colorWidth, colorHeight, defaultExecutor());
+                }
+                depthAfterD2C = transformer->transform(depthFrame);
+                if(depthAfterD2C == nullptr) {
                     continue;
                 }
-                depthD2CFrame = frame->as<ob::DepthFrame>();
+                valueScale = depthFrame->getValueScale();
             }
 
-            if(depthD2CFrame == nullptr) {
-                continue;
-            }
-
-            valueScale    = depthD2CFrame->as<ob::DepthFrame>()->getValueScale();
-            depthAfterD2C = (uint16_t *)depthD2CFrame->data();
-
             // Convert the coordinates of the center point of Color to Depth coordinates
             OBPoint2f sourcePoint2f;
             sourcePoint2f.x = colorWidth / 2;
@@ -0,0 +1,146 @@
+#include "libobsensor/ObSensor.hpp"
+#include "unpack.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Pack pixels into the big-endian bit stream of Y10/Y11/Y12/Y14
+std::vector<uint8_t> packBits(const std::vector<uint16_t> &pixels, uint32_t bits) {
+    std::vector<uint8_t> packed((pixels.size() * bits + 7) / 8, 0);
+    size_t               position = 0;
+    for(auto pixel: pixels) {
+        for(int bit = static_cast<int>(bits) - 1; bit >= 0; bit--, position++) {
+            if((pixel >> bit) & 1) {
+                packed[position / 8] |= static_cast<uint8_t>(0x80 >> (position % 8));
+            }
+        }
+    }
+    return packed;
+}
+
+// One bit at a time, the reference the kernels are checked against
+void unpackReference(const uint8_t *src, uint32_t bits, size_t count, uint16_t *dst) {
+    size_t position = 0;
+    for(size_t i = 0; i < count; i++) {
+        uint32_t pixel = 0;
+        for(uint32_t bit = 0; bit < bits; bit++, position++) {
+            pixel = (pixel << 1) | ((src[position / 8] >> (7 - position % 8)) & 1);
+        }
+        dst[i] = static_cast<uint16_t>(pixel);
+    }
+}
+
+void appendWord(std::vector<uint8_t> &encoded, uint32_t word) {
+    for(int k = 0; k < 4; k++) {
+        encoded.push_back(static_cast<uint8_t>(word >> (8 * k)));
+    }
+}
+
+// RVL encoding of A. Wilson, to produce the input of the decoder
+std::vector<uint8_t> encodeRvl(const std::vector<uint16_t> &pixels) {
+    std::vector<uint8_t> encoded;
+    uint32_t             word    = 0;
+    uint32_t             nibbles = 0;
+    auto                 encode  = [&](uint32_t value) {
+        do {
+            uint32_t nibble = value & 0x7;
+            value >>= 3;
+            if(value) {
+                nibble |= 0x8;
+            }
+            word = (word << 4) | nibble;
+            if(++nibbles == 8) {
+                appendWord(encoded, word);
+                word    = 0;
+                nibbles = 0;
+            }
+        } while(value);
+    };
+
+    int32_t previous = 0;
+    size_t  i        = 0;
+    while(i < pixels.size()) {
+        size_t zeros = i;
+        while(zeros < pixels.size() && pixels[zeros] == 0) {
+            zeros++;
+        }
+        size_t values = zeros;
+        while(values < pixels.size() && pixels[values] != 0) {
+            values++;
+        }
+        encode(static_cast<uint32_t>(zeros - i));
+        encode(static_cast<uint32_t>(values - zeros));
+        for(i = zeros; i < values; i++) {
+            int32_t delta = pixels[i] - previous;
+            encode(static_cast<uint32_t>((delta << 1) ^ (delta >> 31)));
+            previous = pixels[i];
+        }
+    }
+    if(nibbles) {
+        appendWord(encoded, word << (4 * (8 - nibbles)));
+    }
+    return encoded;
+}
+
+// Megapixels per second of body over iterations runs
+template <typename Body> double measure(size_t pixels, int iterations, Body body) {
+    body();
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < iterations; i++) {
+        body();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return static_cast<double>(pixels) * iterations / seconds / 1e6;
+}
+
+int main(int argc, char **argv) {
+    uint32_t width      = argc > 2 ? static_cast<uint32_t>(atoi(argv[1])) : 1280;
+    uint32_t height     = argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : 800;
+    int      iterations = argc > 3 ? atoi(argv[3]) : 100;
+    size_t   count      = static_cast<size_t>(width) * height;
+
+    std::cout << "Unpacking " << width << "x" << height << " frames, " << iterations << " iterations, kernel " << FrameUnpacker::kernel() << std::endl;
+    std::cout << std::fixed << std::setprecision(0);
+
+    std::mt19937          random(1);
+    std::vector<uint16_t> unpacked(count);
+    std::vector<uint16_t> expected(count);
+    FrameUnpacker         serial;
+    FrameUnpacker         parallel(defaultExecutor());
+    for(uint32_t bits: { 10u, 11u, 12u, 14u }) {
+        std::vector<uint16_t> pixels(count);
+        for(auto &pixel: pixels) {
+            pixel = static_cast<uint16_t>(random() & ((1u << bits) - 1));
+        }
+        auto packed = packBits(pixels, bits);
+
+        double reference = measure(count, iterations, [&]() { unpackReference(packed.data(), bits, count, expected.data()); });
+        double single    = measure(count, iterations, [&]() { serial.unpack(packed.data(), packed.size(), bits, count, unpacked.data()); });
+        bool   match     = unpacked == pixels;
+        double threads   = measure(count, iterations, [&]() { parallel.unpack(packed.data(), packed.size(), bits, count, unpacked.data()); });
+        match            = match && unpacked == pixels && expected == pixels;
+        std::cout << "Y" << bits << ": reference " << reference << " MP/s, kernel " << single << " MP/s, kernel on the executor " << threads << " MP/s"
+                  << (match ? "" : ", MISMATCH") << std::endl;
+    }
+
+    // Depth-like content: smooth surfaces with holes
+    std::vector<uint16_t> depth(count);
+    for(size_t i = 0; i < count; i++) {
+        depth[i] = random() % 10 == 0 ? 0 : static_cast<uint16_t>(1000 + (i % width) / 4 + random() % 4);
+    }
+    auto   encoded = encodeRvl(depth);
+    bool   decoded = true;
+    double rvl     = measure(count, iterations, [&]() { decoded = FrameUnpacker::decodeRvl(encoded.data(), encoded.size(), count, unpacked.data()); });
+    std::cout << "RVL: " << rvl << " MP/s, " << std::setprecision(2) << static_cast<double>(encoded.size()) / (count * sizeof(uint16_t))
+              << " of Y16" << (decoded && unpacked == depth ? "" : ", MISMATCH") << std::endl;
+
+    // Upper bound: copying the unpacked size
+    std::vector<uint16_t> copy(count);
+    double                memcpyRate = measure(count, iterations, [&]() { memcpy(copy.data(), depth.data(), count * sizeof(uint16_t)); });
+    std::cout << std::setprecision(0) << "memcpy of Y16: " << memcpyRate << " MP/s" << std::endl;
+    return 0;
+}
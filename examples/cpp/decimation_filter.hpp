@@ -0,0 +1,326 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+#include "executor.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Value of an output pixel of a HostDecimationFilter, computed over the valid (non-zero) pixels of its block
+enum DecimationMode {
+    DECIMATION_AUTO,    // median for the scales 2 and 3, mean for the larger scales
+    DECIMATION_MEDIAN,  // lower median
+    DECIMATION_MEAN,    // mean rounded to nearest
+};
+
+// Host side decimation filter: each block of scale x scale pixels of a Y16 depth frame gives one output pixel, the median
+// or the mean of its valid pixels, 0 when the block has none. The output has the size of the frame divided by the scale,
+// the last columns and rows that do not fill a block are dropped.
+//
+// A depth range can be fused into the same pass: the pixels outside of [min, max] millimeters are invalidated while the
+// frame is read, which gives the output of a ThresholdFilter followed by the decimation with a single read of the full
+// resolution frame.
+// A row band of blocks is first split in one plane per pixel position in the block, then the planes are combined 8 output
+// pixels at a time: the median by a sorting network with SSE2 or NEON min/max, the mean by sums the compiler vectorizes.
+// The row bands run in parallel on the executor given at construction.
+class HostDecimationFilter {
+public:
+    explicit HostDecimationFilter(std::shared_ptr<Executor> executor = nullptr) : executor_(executor), enabled_(true) {
+        params_.scale        = 2;
+        params_.mode         = DECIMATION_AUTO;
+        params_.thresholdMin = 0;
+        params_.thresholdMax = 0;
+    }
+
+    const char *type() const {
+        return "HostDecimationFilter";
+    }
+
+    void enable(bool enable) {
+        enabled_ = enable;
+    }
+
+    bool isEnabled() const {
+        return enabled_;
+    }
+
+    // Scale in [1, 8], 1 passes the frames through
+    void setScaleValue(uint8_t scale) {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        params_.scale = std::min<uint8_t>(8, std::max<uint8_t>(1, scale));
+    }
+
+    uint8_t getScaleValue() {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        return params_.scale;
+    }
+
+    void setMode(DecimationMode mode) {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        params_.mode = mode;
+    }
+
+    DecimationMode getMode() {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        return params_.mode;
+    }
+
+    // Invalidate the depth outside of [min, max] millimeters before the decimation, as a ThresholdFilter would
+    void setThreshold(uint16_t min, uint16_t max) {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        params_.thresholdMin = min;
+        params_.thresholdMax = max;
+    }
+
+    void clearThreshold() {
+        setThreshold(0, 0);
+    }
+
+    std::shared_ptr<ob::Frame> process(std::shared_ptr<ob::Frame> frame) {
+        if(!enabled_ || frame == nullptr || frame->type() != OB_FRAME_DEPTH || frame->format() != OB_FORMAT_Y16) {
+            return frame;
+        }
+        Params params;
+        {
+            std::lock_guard<std::mutex> lock(paramsMutex_);
+            params = params_;
+        }
+
+        auto     depthFrame = frame->as<ob::DepthFrame>();
+        uint32_t width      = depthFrame->width();
+        uint32_t height     = depthFrame->height();
+        uint32_t scale      = params.scale;
+        bool     threshold  = params.thresholdMax > 0;
+        if(scale == 1 && !threshold) {
+            return frame;
+        }
+        if(width < scale || height < scale || frame->dataSize() < static_cast<uint64_t>(width) * height * sizeof(uint16_t)) {
+            return frame;
+        }
+
+        // The range in the unit of the frame
+        float    valueScale = depthFrame->getValueScale() > 0 ? depthFrame->getValueScale() : 1.0f;
+        uint16_t minValue   = 0;
+        uint16_t maxValue   = 0xffff;
+        if(threshold) {
+            minValue = static_cast<uint16_t>(std::min(65535.0f, std::ceil(params.thresholdMin / valueScale)));
+            maxValue = static_cast<uint16_t>(std::min(65535.0f, std::floor(params.thresholdMax / valueScale)));
+        }
+
+        Image image;
+        image.src      = reinterpret_cast<const uint16_t *>(frame->data());
+        image.stride   = width;
+        image.width    = width / scale;
+        image.height   = height / scale;
+        image.scale    = scale;
+        image.median   = params.mode == DECIMATION_MEDIAN || (params.mode == DECIMATION_AUTO && scale <= 3);
+        image.minValue = minValue;
+        image.maxValue = maxValue;
+
+        auto output = ob::FrameHelper::createFrame(OB_FRAME_DEPTH, OB_FORMAT_Y16, image.width, image.height, 0);
+        ob::FrameHelper::setFrameDeviceTimestampUs(output, frame->timeStampUs());
+        ob::FrameHelper::setFrameSystemTimestamp(output, frame->systemTimeStamp());
+        image.dst = reinterpret_cast<uint16_t *>(output->data());
+        if(image.median) {
+            sortPairs(scale * scale, image.pairs, image.sortSize);
+        }
+        forEachBand(image.height, [this, &image](uint32_t y0, uint32_t y1) { processRows(image, y0, y1); });
+        return output;
+    }
+
+private:
+    struct Params {
+        uint8_t        scale;
+        DecimationMode mode;
+        uint16_t       thresholdMin;  // millimeters, thresholdMax = 0 disables the range
+        uint16_t       thresholdMax;
+    };
+
+    struct Image {
+        const uint16_t      *src;
+        uint16_t            *dst;
+        uint32_t             stride;
+        uint32_t             width;     // size of the output
+        uint32_t             height;    //
+        uint32_t             scale;
+        bool                 median;
+        uint16_t             minValue;  // valid range in the unit of the frame
+        uint16_t             maxValue;  //
+        uint32_t             sortSize;  // number of inputs of the sorting network, a power of 2
+        std::vector<uint8_t> pairs;     // compare-exchanges of the sorting network
+    };
+
+    std::shared_ptr<Executor> executor_;
+    bool                      enabled_;
+    std::mutex                paramsMutex_;
+    Params                    params_;
+
+    void forEachBand(uint32_t count, const std::function<void(uint32_t, uint32_t)> &body) {
+        if(!executor_) {
+            body(0, count);
+            return;
+        }
+        parallelFor(*executor_, 0, count, 4, [&body](size_t begin, size_t end) { body(static_cast<uint32_t>(begin), static_cast<uint32_t>(end)); });
+    }
+
+    // Batcher's odd-even merge sort of size inputs rounded up to a power of 2
+    static void sortPairs(uint32_t size, std::vector<uint8_t> &pairs, uint32_t &sortSize) {
+        sortSize = 1;
+        while(sortSize < size) {
+            sortSize <<= 1;
+        }
+        pairs.clear();
+        for(uint32_t p = 1; p < sortSize; p <<= 1) {
+            for(uint32_t k = p; k >= 1; k >>= 1) {
+                for(uint32_t j = k % p; j + k < sortSize; j += 2 * k) {
+                    for(uint32_t i = 0; i < std::min(k, sortSize - j - k); i++) {
+                        if((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+                            pairs.push_back(static_cast<uint8_t>(i + j));
+                            pairs.push_back(static_cast<uint8_t>(i + j + k));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void processRows(const Image &image, uint32_t rowBegin, uint32_t rowEnd) const {
+        const uint32_t        scale  = image.scale;
+        const uint32_t        count  = scale * scale;
+        const uint32_t        width  = image.width;
+        std::vector<uint16_t> planes(static_cast<size_t>(count) * width);
+        std::vector<uint32_t> sum(width);
+        std::vector<uint16_t> valid(width);
+        for(uint32_t y = rowBegin; y < rowEnd; y++) {
+            // Plane dy * scale + dx holds the pixel (dx, dy) of each block of the row, out of range pixels as 0
+            for(uint32_t dy = 0; dy < scale; dy++) {
+                const uint16_t *src = image.src + static_cast<size_t>(y * scale + dy) * image.stride;
+                for(uint32_t dx = 0; dx < scale; dx++) {
+                    uint16_t *plane = &planes[static_cast<size_t>(dy * scale + dx) * width];
+                    for(uint32_t x = 0; x < width; x++) {
+                        uint16_t value = src[x * scale + dx];
+                        plane[x]       = value >= image.minValue && value <= image.maxValue ? value : 0;
+                    }
+                }
+            }
+            uint16_t *dst = image.dst + static_cast<size_t>(y) * width;
+            if(image.median) {
+                medianRow(image, planes.data(), dst);
+            }
+            else {
+                meanRow(count, width, planes.data(), sum.data(), valid.data(), dst);
+            }
+        }
+    }
+
+    // Mean of the non-zero values of the planes, (sum + valid / 2) / valid computed in float, exact for sums below 2^24
+    static void meanRow(uint32_t count, uint32_t width, const uint16_t *planes, uint32_t *sum, uint16_t *valid, uint16_t *dst) {
+        std::fill(sum, sum + width, 0u);
+        std::fill(valid, valid + width, static_cast<uint16_t>(0));
+        for(uint32_t e = 0; e < count; e++) {
+            const uint16_t *plane = planes + static_cast<size_t>(e) * width;
+            for(uint32_t x = 0; x < width; x++) {
+                sum[x] += plane[x];
+                valid[x] += plane[x] != 0 ? 1 : 0;
+            }
+        }
+        for(uint32_t x = 0; x < width; x++) {
+            float mean = static_cast<float>(sum[x] + valid[x] / 2) / static_cast<float>(std::max<uint16_t>(valid[x], 1));
+            dst[x]     = static_cast<uint16_t>(mean);
+        }
+    }
+
+    // Lower median of the non-zero values of the planes. The sorting network puts the zeros first, the median of the valid
+    // values of a pixel is then at zeros + (count - zeros - 1) / 2, and at count - 1 (a zero) when all are zeros.
+    static void medianRow(const Image &image, const uint16_t *planes, uint16_t *dst) {
+        const uint32_t count    = image.scale * image.scale;
+        const uint32_t width    = image.width;
+        const size_t   pairs    = image.pairs.size() / 2;
+        const uint8_t *pair     = image.pairs.data();
+        const uint32_t firstMid = (count - 1) / 2;
+        uint32_t       x        = 0;
+#if defined(OB_EXAMPLES_SSE2)
+        // Unsigned order with the signed min/max of SSE2: values are biased by 0x8000, 0 becomes the smallest
+        const __m128i bias     = _mm_set1_epi16(static_cast<short>(0x8000));
+        const __m128i sentinel = _mm_set1_epi16(0x7fff);
+        const __m128i one      = _mm_set1_epi16(1);
+        const __m128i total    = _mm_set1_epi16(static_cast<short>(count));
+        __m128i       v[64];
+        for(; x + 8 <= width; x += 8) {
+            __m128i zeros = _mm_setzero_si128();
+            for(uint32_t e = 0; e < count; e++) {
+                __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(planes + static_cast<size_t>(e) * width + x));
+                zeros         = _mm_sub_epi16(zeros, _mm_cmpeq_epi16(value, _mm_setzero_si128()));
+                v[e]          = _mm_xor_si128(value, bias);
+            }
+            for(uint32_t e = count; e < image.sortSize; e++) {
+                v[e] = sentinel;
+            }
+            for(size_t p = 0; p < pairs; p++) {
+                __m128i a          = v[pair[2 * p]];
+                __m128i b          = v[pair[2 * p + 1]];
+                v[pair[2 * p]]     = _mm_min_epi16(a, b);
+                v[pair[2 * p + 1]] = _mm_max_epi16(a, b);
+            }
+            __m128i index  = _mm_add_epi16(zeros, _mm_srai_epi16(_mm_sub_epi16(_mm_sub_epi16(total, zeros), one), 1));
+            __m128i median = _mm_setzero_si128();
+            for(uint32_t e = firstMid; e < count; e++) {
+                __m128i select = _mm_cmpeq_epi16(index, _mm_set1_epi16(static_cast<short>(e)));
+                median         = _mm_or_si128(median, _mm_and_si128(select, v[e]));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_xor_si128(median, bias));
+        }
+#elif defined(OB_EXAMPLES_NEON)
+        const uint16x8_t sentinel = vdupq_n_u16(0xffff);
+        const int16x8_t  total    = vdupq_n_s16(static_cast<int16_t>(count));
+        uint16x8_t       v[64];
+        for(; x + 8 <= width; x += 8) {
+            int16x8_t zeros = vdupq_n_s16(0);
+            for(uint32_t e = 0; e < count; e++) {
+                v[e]  = vld1q_u16(planes + static_cast<size_t>(e) * width + x);
+                zeros = vsubq_s16(zeros, vreinterpretq_s16_u16(vceqq_u16(v[e], vdupq_n_u16(0))));
+            }
+            for(uint32_t e = count; e < image.sortSize; e++) {
+                v[e] = sentinel;
+            }
+            for(size_t p = 0; p < pairs; p++) {
+                uint16x8_t a       = v[pair[2 * p]];
+                uint16x8_t b       = v[pair[2 * p + 1]];
+                v[pair[2 * p]]     = vminq_u16(a, b);
+                v[pair[2 * p + 1]] = vmaxq_u16(a, b);
+            }
+            int16x8_t  index  = vaddq_s16(zeros, vshrq_n_s16(vsubq_s16(vsubq_s16(total, zeros), vdupq_n_s16(1)), 1));
+            uint16x8_t median = vdupq_n_u16(0);
+            for(uint32_t e = firstMid; e < count; e++) {
+                median = vbslq_u16(vceqq_s16(index, vdupq_n_s16(static_cast<int16_t>(e))), v[e], median);
+            }
+            vst1q_u16(dst + x, median);
+        }
+#endif
+        // Same selection as the vector kernels
+        uint16_t values[64];
+        for(; x < width; x++) {
+            uint32_t valid = 0;
+            for(uint32_t e = 0; e < count; e++) {
+                uint16_t value = planes[static_cast<size_t>(e) * width + x];
+                if(value != 0) {
+                    values[valid++] = value;
+                }
+            }
+            if(valid == 0) {
+                dst[x] = 0;
+                continue;
+            }
+            std::nth_element(values, values + (valid - 1) / 2, values + valid);
+            dst[x] = values[(valid - 1) / 2];
+        }
+    }
+};
@@ -0,0 +1,201 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+#include "executor.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// Part of a Y16 depth frame processed by a DepthFilter: the region of interest and its halo, or the whole frame
+struct DepthImage {
+    const uint16_t *src;          // first pixel of the region in the input frame
+    uint16_t       *dst;          // first pixel of the region in the output frame
+    uint32_t        width;        // size of the region
+    uint32_t        height;       //
+    uint32_t        stride;       // pixels between two rows, the width of the frame
+    uint32_t        x;            // position of the region in the frame
+    uint32_t        y;            //
+    uint32_t        frameWidth;   // size of the frame
+    uint32_t        frameHeight;  //
+};
+
+// Output of a DepthFilter outside of its region of interest
+enum RoiOutside {
+    ROI_OUTSIDE_PASS_THROUGH,  // the input depth, unfiltered
+    ROI_OUTSIDE_ZERO,          // invalid depth
+};
+
+// Base of the host side depth filters of the examples.
+//
+// process() takes a Y16 depth frame and returns a new depth frame with the same size and timestamps, other frames are
+// returned unchanged. The depth value scale is not carried by the new frame, keep using the value scale of the source frame.
+// The work is split in row bands over the executor given at construction, or runs on the calling thread without executor.
+// With a region of interest the filter only computes the region and the halo of pixels it reads around it, so its cost is
+// proportional to the area of the region.
+// A filter instance processes one frame at a time, run it from one thread or from a FilterGraph stage.
+class DepthFilter {
+public:
+    explicit DepthFilter(std::shared_ptr<Executor> executor = nullptr) : executor_(executor), enabled_(true), outside_(ROI_OUTSIDE_PASS_THROUGH) {
+        roi_.x      = 0;
+        roi_.y      = 0;
+        roi_.width  = 0;
+        roi_.height = 0;
+    }
+
+    virtual ~DepthFilter() {}
+
+    virtual const char *type() const = 0;
+
+    void enable(bool enable) {
+        enabled_ = enable;
+    }
+
+    bool isEnabled() const {
+        return enabled_;
+    }
+
+    // Drop the state kept from the previous frames
+    virtual void reset() {}
+
+    // Filter only the pixels of roi, the other pixels are passed through or zeroed. The part of roi outside of the frame is
+    // ignored. A roi of size 0 filters the whole frame.
+    void setRoi(const OBRect &roi, RoiOutside outside = ROI_OUTSIDE_PASS_THROUGH) {
+        std::lock_guard<std::mutex> lock(roiMutex_);
+        roi_     = roi;
+        outside_ = outside;
+    }
+
+    void clearRoi() {
+        OBRect full = { 0, 0, 0, 0 };
+        setRoi(full);
+    }
+
+    OBRect getRoi() {
+        std::lock_guard<std::mutex> lock(roiMutex_);
+        return roi_;
+    }
+
+    std::shared_ptr<ob::Frame> process(std::shared_ptr<ob::Frame> frame) {
+        if(!enabled_ || frame == nullptr || frame->type() != OB_FRAME_DEPTH || frame->format() != OB_FORMAT_Y16) {
+            return frame;
+        }
+
+        auto     videoFrame = frame->as<ob::VideoFrame>();
+        uint32_t width      = videoFrame->width();
+        uint32_t height     = videoFrame->height();
+        if(width == 0 || height == 0 || frame->dataSize() < static_cast<uint64_t>(width) * height * sizeof(uint16_t)) {
+            return frame;
+        }
+
+        auto output = ob::FrameHelper::createFrame(OB_FRAME_DEPTH, OB_FORMAT_Y16, width, height, 0);
+        ob::FrameHelper::setFrameDeviceTimestampUs(output, frame->timeStampUs());
+        ob::FrameHelper::setFrameSystemTimestamp(output, frame->systemTimeStamp());
+
+        OBRect     roi;
+        RoiOutside outside;
+        {
+            std::lock_guard<std::mutex> lock(roiMutex_);
+            roi     = roi_;
+            outside = outside_;
+        }
+        bool useRoi = roi.width > 0 && roi.height > 0;
+        if(!useRoi) {
+            roi.x      = 0;
+            roi.y      = 0;
+            roi.width  = width;
+            roi.height = height;
+        }
+        roi.x      = std::min(roi.x, width);
+        roi.y      = std::min(roi.y, height);
+        roi.width  = std::min(roi.width, width - roi.x);
+        roi.height = std::min(roi.height, height - roi.y);
+
+        auto src = reinterpret_cast<const uint16_t *>(frame->data());
+        auto dst = reinterpret_cast<uint16_t *>(output->data());
+        loadParams();
+        if(roi.width > 0 && roi.height > 0) {
+            // The halo gives the pixels of the region their real neighbors, its output is replaced below
+            uint32_t halo = haloSize();
+            uint32_t x0   = roi.x - std::min(roi.x, halo);
+            uint32_t y0   = roi.y - std::min(roi.y, halo);
+            uint32_t x1   = roi.x + roi.width + std::min(width - roi.x - roi.width, halo);
+            uint32_t y1   = roi.y + roi.height + std::min(height - roi.y - roi.height, halo);
+
+            DepthImage image;
+            image.src         = src + static_cast<size_t>(y0) * width + x0;
+            image.dst         = dst + static_cast<size_t>(y0) * width + x0;
+            image.width       = x1 - x0;
+            image.height      = y1 - y0;
+            image.stride      = width;
+            image.x           = x0;
+            image.y           = y0;
+            image.frameWidth  = width;
+            image.frameHeight = height;
+            processImage(image);
+        }
+        if(useRoi) {
+            fillOutside(src, dst, width, height, roi, outside);
+        }
+        return output;
+    }
+
+protected:
+    // Take the parameters for the next frame, called before haloSize() and processImage()
+    virtual void loadParams() {}
+
+    // Pixels read around each output pixel, the region of interest is extended by this many pixels on each side
+    virtual uint32_t haloSize() const {
+        return 0;
+    }
+
+    // Process a whole image. The default implementation runs processRows() over row bands in parallel.
+    virtual void processImage(const DepthImage &image) {
+        forEachBand(image.height, [this, &image](uint32_t rowBegin, uint32_t rowEnd) { processRows(image, rowBegin, rowEnd); });
+    }
+
+    // Process the rows [rowBegin, rowEnd) of the image, called concurrently on disjoint row ranges
+    virtual void processRows(const DepthImage &image, uint32_t rowBegin, uint32_t rowEnd) {
+        (void)image;
+        (void)rowBegin;
+        (void)rowEnd;
+    }
+
+    // Run body over bands of [0, count) rows or columns, in parallel when the filter has an executor
+    void forEachBand(uint32_t count, const std::function<void(uint32_t, uint32_t)> &body, uint32_t minCount = 16) {
+        if(!executor_) {
+            body(0, count);
+            return;
+        }
+        parallelFor(*executor_, 0, count, minCount, [&body](size_t begin, size_t end) { body(static_cast<uint32_t>(begin), static_cast<uint32_t>(end)); });
+    }
+
+    std::shared_ptr<Executor> executor_;
+
+private:
+    bool       enabled_;
+    std::mutex roiMutex_;
+    OBRect     roi_;
+    RoiOutside outside_;
+
+    static void fillOutside(const uint16_t *src, uint16_t *dst, uint32_t width, uint32_t height, const OBRect &roi, RoiOutside outside) {
+        auto fill = [src, dst, outside](size_t offset, size_t count) {
+            if(outside == ROI_OUTSIDE_ZERO) {
+                memset(dst + offset, 0, count * sizeof(uint16_t));
+            }
+            else {
+                memcpy(dst + offset, src + offset, count * sizeof(uint16_t));
+            }
+        };
+        fill(0, static_cast<size_t>(roi.y) * width);
+        for(uint32_t y = roi.y; y < roi.y + roi.height; y++) {
+            fill(static_cast<size_t>(y) * width, roi.x);
+            fill(static_cast<size_t>(y) * width + roi.x + roi.width, width - roi.x - roi.width);
+        }
+        fill(static_cast<size_t>(roi.y + roi.height) * width, static_cast<size_t>(height - roi.y - roi.height) * width);
+    }
+};
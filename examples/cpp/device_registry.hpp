@@ -0,0 +1,245 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Descriptor of a connected device, copied out of the ob::DeviceList it was reported in
+struct DeviceDescriptor {
+    std::string uid;
+    std::string serialNumber;
+    std::string connectionType;
+    std::string ipAddress;  // empty for USB devices
+    int         pid;
+    int         vid;
+};
+
+// Host side registry of the connected devices, keyed by uid and serial number.
+//
+// Context::queryDeviceList() enumerates the devices again on every call (USB and, when enabled, network discovery).
+// DeviceRegistry enumerates once with refresh() and then applies the added and removed lists of the device changed
+// callback incrementally, so that listing or looking up the devices is answered from host memory without any device
+// traffic. Net devices discovered after Context::enableNetDeviceEnumeration(true) are reported through the same callback.
+class DeviceRegistry {
+public:
+    typedef std::function<void(std::shared_ptr<ob::DeviceList> removedList, std::shared_ptr<ob::DeviceList> addedList)> DeviceChangedCallback;
+
+    explicit DeviceRegistry(ob::Context &context) : context_(context), state_(std::make_shared<State>()) {
+        std::weak_ptr<State> weakState = state_;
+        context_.setDeviceChangedCallback([weakState](std::shared_ptr<ob::DeviceList> removedList, std::shared_ptr<ob::DeviceList> addedList) {
+            auto state = weakState.lock();
+            if(!state) {
+                return;
+            }
+            {
+                // Tell a refresh() running now that its enumeration may miss this change
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->events++;
+            }
+            state->remove(removedList);
+            state->add(addedList);
+
+            DeviceChangedCallback callback;
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                callback = state->changedCallback;
+            }
+            if(callback) {
+                callback(removedList, addedList);
+            }
+        });
+    }
+
+    // The registry owns the device changed callback of the context, register the application callback here.
+    void setDeviceChangedCallback(DeviceChangedCallback callback) {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->changedCallback = callback;
+    }
+
+    // Enumerate all the devices and replace the registry content. Call it once after construction to populate the registry,
+    // the device changed events keep it up to date afterwards. Returns the device list that was queried.
+    // A device changed event handled during the enumeration may not be in the list, the enumeration is then done again. If
+    // events keep coming, the last list is merged into the registry instead of replacing it, without the devices removed by
+    // an event since the enumeration started, so no event is lost.
+    std::shared_ptr<ob::DeviceList> refresh() {
+        const int                       maxAttempts = 3;
+        std::shared_ptr<ob::DeviceList> list;
+        for(int attempt = 1;; attempt++) {
+            uint64_t events;
+            {
+                std::lock_guard<std::mutex> lock(state_->mutex);
+                events = state_->events;
+            }
+            list         = context_.queryDeviceList();
+            auto entries = State::describe(list);
+
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            if(events == state_->events) {
+                state_->entries.clear();
+                state_->uidBySerialNumber.clear();
+                state_->insert(entries);
+                return list;
+            }
+            if(attempt == maxAttempts) {
+                std::vector<Entry> merged;
+                for(auto &entry: entries) {
+                    auto removed = state_->removedAt.find(entry.descriptor.uid);
+                    if(removed == state_->removedAt.end() || removed->second <= events || state_->entries.count(entry.descriptor.uid) > 0) {
+                        merged.push_back(entry);
+                    }
+                }
+                state_->insert(merged);
+                return list;
+            }
+        }
+    }
+
+    std::vector<DeviceDescriptor> devices() const {
+        std::vector<DeviceDescriptor> result;
+        std::lock_guard<std::mutex>   lock(state_->mutex);
+        result.reserve(state_->entries.size());
+        for(auto &entry: state_->entries) {
+            result.push_back(entry.second.descriptor);
+        }
+        return result;
+    }
+
+    size_t deviceCount() const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        return state_->entries.size();
+    }
+
+    // Incremented on every change of the registry content, a poller can skip its work while it is unchanged
+    uint64_t generation() const {
+        return state_->generation;
+    }
+
+    bool findByUid(const std::string &uid, DeviceDescriptor &descriptor) const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        auto                        iter = state_->entries.find(uid);
+        if(iter == state_->entries.end()) {
+            return false;
+        }
+        descriptor = iter->second.descriptor;
+        return true;
+    }
+
+    bool findBySerialNumber(const std::string &serialNumber, DeviceDescriptor &descriptor) const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        auto                        iter = state_->uidBySerialNumber.find(serialNumber);
+        if(iter == state_->uidBySerialNumber.end()) {
+            return false;
+        }
+        descriptor = state_->entries.at(iter->second).descriptor;
+        return true;
+    }
+
+    // Open a registered device from the device list it was reported in, no enumeration is done.
+    // Returns nullptr if the device is not registered.
+    std::shared_ptr<ob::Device> openDevice(const std::string &uid) const {
+        std::shared_ptr<ob::DeviceList> list;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            auto                        iter = state_->entries.find(uid);
+            if(iter == state_->entries.end()) {
+                return nullptr;
+            }
+            list = iter->second.list;
+        }
+        return list->getDeviceByUid(uid.c_str());
+    }
+
+private:
+    struct Entry {
+        DeviceDescriptor                descriptor;
+        std::shared_ptr<ob::DeviceList> list;  // list the device was reported in, used to open it
+    };
+
+    struct State {
+        mutable std::mutex                 mutex;
+        std::map<std::string, Entry>       entries;  // keyed by uid
+        std::map<std::string, std::string> uidBySerialNumber;
+        DeviceChangedCallback              changedCallback;
+        std::atomic<uint64_t>              generation{ 0 };
+        uint64_t                           events = 0;  // device changed events received
+        std::map<std::string, uint64_t>    removedAt;   // event count when each uid was last removed
+
+        void add(std::shared_ptr<ob::DeviceList> list) {
+            if(list == nullptr || list->deviceCount() == 0) {
+                return;
+            }
+
+            // Read the descriptors before taking the lock, the accessors are calls into the SDK
+            auto                        added = describe(list);
+            std::lock_guard<std::mutex> lock(mutex);
+            insert(added);
+        }
+
+        // Entries of the devices of list
+        static std::vector<Entry> describe(std::shared_ptr<ob::DeviceList> list) {
+            std::vector<Entry> added;
+            if(list == nullptr) {
+                return added;
+            }
+            for(uint32_t i = 0; i < list->deviceCount(); i++) {
+                Entry entry;
+                entry.descriptor.uid            = list->uid(i);
+                entry.descriptor.serialNumber   = list->serialNumber(i);
+                entry.descriptor.connectionType = list->connectionType(i);
+                entry.descriptor.pid            = list->pid(i);
+                entry.descriptor.vid            = list->vid(i);
+                if(entry.descriptor.connectionType == "Ethernet") {
+                    entry.descriptor.ipAddress = list->ipAddress(i);
+                }
+                entry.list = list;
+                added.push_back(entry);
+            }
+            return added;
+        }
+
+        // Called with the mutex locked
+        void insert(const std::vector<Entry> &added) {
+            for(auto &entry: added) {
+                uidBySerialNumber[entry.descriptor.serialNumber] = entry.descriptor.uid;
+                entries[entry.descriptor.uid]                    = entry;
+            }
+            generation++;
+        }
+
+        void remove(std::shared_ptr<ob::DeviceList> list) {
+            if(list == nullptr || list->deviceCount() == 0) {
+                return;
+            }
+
+            std::vector<std::string> removed;
+            for(uint32_t i = 0; i < list->deviceCount(); i++) {
+                removed.push_back(list->uid(i));
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            for(auto &uid: removed) {
+                removedAt[uid] = events;
+                auto iter      = entries.find(uid);
+                if(iter == entries.end()) {
+                    continue;
+                }
+                auto snIter = uidBySerialNumber.find(iter->second.descriptor.serialNumber);
+                if(snIter != uidBySerialNumber.end() && snIter->second == uid) {
+                    uidBySerialNumber.erase(snIter);
+                }
+                entries.erase(iter);
+            }
+            generation++;
+        }
+    };
+
+    ob::Context           &context_;
+    std::shared_ptr<State> state_;
+};
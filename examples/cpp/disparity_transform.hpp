@@ -0,0 +1,275 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+#include "executor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Output of a HostDisparityTransform
+enum DisparityPrecision {
+    DISPARITY_FIXED_POINT,  // 16 bit, disparities with fraction bits, depths in the depth unit, rounded to nearest
+    DISPARITY_FLOAT,        // float, same units without rounding
+};
+
+// Conversion of the 65536 values of a 16 bit depth or fixed point disparity, disparity = focalLength * baseline / depth.
+// The conversion is its own inverse, one table converts both ways. 0 stays 0 (invalid), fixed point outputs saturate at 65535.
+class DisparityTable {
+public:
+    DisparityTable(float focalBaseline, float depthUnit, uint32_t fractionBits, DisparityPrecision precision) : precision_(precision) {
+        // depth * depthUnit * disparity / 2^fractionBits = focalBaseline, in millimeter pixels
+        double numerator = static_cast<double>(focalBaseline) * (1u << fractionBits) / depthUnit;
+        if(precision_ == DISPARITY_FIXED_POINT) {
+            fixed_.resize(65536);
+            fixed_[0] = 0;
+            for(uint32_t value = 1; value < 65536; value++) {
+                fixed_[value] = static_cast<uint16_t>(std::min(65535.0, std::floor(numerator / value + 0.5)));
+            }
+        }
+        else {
+            values_.resize(65536);
+            values_[0] = 0;
+            for(uint32_t value = 1; value < 65536; value++) {
+                values_[value] = static_cast<float>(numerator / value);
+            }
+        }
+    }
+
+    DisparityPrecision precision() const {
+        return precision_;
+    }
+
+    // Table of DISPARITY_FIXED_POINT, nullptr for DISPARITY_FLOAT
+    const uint16_t *fixed() const {
+        return fixed_.empty() ? nullptr : fixed_.data();
+    }
+
+    // Table of DISPARITY_FLOAT, nullptr for DISPARITY_FIXED_POINT
+    const float *values() const {
+        return values_.empty() ? nullptr : values_.data();
+    }
+
+    size_t memoryUsage() const {
+        return fixed_.size() * sizeof(uint16_t) + values_.size() * sizeof(float);
+    }
+
+private:
+    DisparityPrecision    precision_;
+    std::vector<uint16_t> fixed_;
+    std::vector<float>    values_;
+};
+
+// Disparity tables shared by the process, built once per calibration, depth unit and precision
+class DisparityTableCache {
+public:
+    std::shared_ptr<const DisparityTable> get(float focalBaseline, float depthUnit, uint32_t fractionBits, DisparityPrecision precision) {
+        std::vector<float> key = { focalBaseline, depthUnit, static_cast<float>(fractionBits), static_cast<float>(precision) };
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto                        iter = tables_.find(key);
+        if(iter != tables_.end()) {
+            return iter->second;
+        }
+        auto table   = std::make_shared<const DisparityTable>(focalBaseline, depthUnit, fractionBits, precision);
+        tables_[key] = table;
+        return table;
+    }
+
+    size_t memoryUsage() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t                      bytes = 0;
+        for(auto &entry: tables_) {
+            bytes += entry.second->memoryUsage();
+        }
+        return bytes;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return tables_.size();
+    }
+
+    // Release the tables, the transforms using them keep them alive
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tables_.clear();
+    }
+
+private:
+    mutable std::mutex                                                  mutex_;
+    std::map<std::vector<float>, std::shared_ptr<const DisparityTable>> tables_;
+};
+
+inline DisparityTableCache &disparityTableCache() {
+    static DisparityTableCache cache;
+    return cache;
+}
+
+// Host side conversion between depth and disparity by table lookup instead of a division per pixel.
+//
+// The disparity of a depth is focalLength * baseline / depth (pixels, millimeters), stored as fixed point with
+// fractionBits fraction bits (OB_FORMAT_DISP16 frames) or as float. The tables come from disparityTableCache(), the
+// transforms with the same calibration share them.
+// Depth frames are read in their value scale, or in the depth unit when they have none; the depth written by the disparity
+// to depth direction is in the depth unit (1 mm by default).
+class HostDisparityTransform {
+public:
+    explicit HostDisparityTransform(bool depthToDisparity, std::shared_ptr<Executor> executor = nullptr)
+        : depthToDisparity_(depthToDisparity), executor_(executor), enabled_(true) {
+        params_.focalBaseline = 0;
+        params_.depthUnit     = 1.0f;
+        params_.fractionBits  = 3;
+        params_.precision     = DISPARITY_FIXED_POINT;
+    }
+
+    const char *type() const {
+        return "HostDisparityTransform";
+    }
+
+    void enable(bool enable) {
+        enabled_ = enable;
+    }
+
+    bool isEnabled() const {
+        return enabled_;
+    }
+
+    bool isDepthToDisparity() const {
+        return depthToDisparity_;
+    }
+
+    // Focal length of the depth sensor in pixels and baseline in millimeters, see OB_STRUCT_BASELINE_CALIBRATION_PARAM
+    void setCalibration(float focalLength, float baseline) {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        params_.focalBaseline = focalLength * baseline;
+    }
+
+    // Fixed point disparities have fractionBits in [0, 8] fraction bits
+    void setPrecision(DisparityPrecision precision, uint32_t fractionBits = 3) {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        params_.precision    = precision;
+        params_.fractionBits = std::min<uint32_t>(fractionBits, 8);
+    }
+
+    uint32_t fractionBits() {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        return params_.fractionBits;
+    }
+
+    DisparityPrecision precision() {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        return params_.precision;
+    }
+
+    // Millimeters of a depth value, for the output depth and the depth frames without value scale
+    void setDepthUnit(float depthUnit) {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        params_.depthUnit = depthUnit > 0 ? depthUnit : 1.0f;
+    }
+
+    // Converts a Y16 depth frame to an OB_FORMAT_DISP16 frame, or back, with the fixed point precision. Other frames, and all
+    // frames before setCalibration(), are returned unchanged.
+    std::shared_ptr<ob::Frame> process(std::shared_ptr<ob::Frame> frame) {
+        OBFormat input = depthToDisparity_ ? OB_FORMAT_Y16 : OB_FORMAT_DISP16;
+        if(!enabled_ || frame == nullptr || frame->type() != OB_FRAME_DEPTH || frame->format() != input) {
+            return frame;
+        }
+        auto     depthFrame = frame->as<ob::DepthFrame>();
+        uint32_t width      = depthFrame->width();
+        uint32_t height     = depthFrame->height();
+        size_t   count      = static_cast<size_t>(width) * height;
+        if(frame->dataSize() < count * sizeof(uint16_t)) {
+            return frame;
+        }
+        auto table = fixedTable(depthFrame->getValueScale());
+        if(!table) {
+            return frame;
+        }
+
+        auto output = ob::FrameHelper::createFrame(OB_FRAME_DEPTH, depthToDisparity_ ? OB_FORMAT_DISP16 : OB_FORMAT_Y16, width, height, 0);
+        ob::FrameHelper::setFrameDeviceTimestampUs(output, frame->timeStampUs());
+        ob::FrameHelper::setFrameSystemTimestamp(output, frame->systemTimeStamp());
+        lookup(table->fixed(), reinterpret_cast<const uint16_t *>(frame->data()), count, reinterpret_cast<uint16_t *>(output->data()));
+        return output;
+    }
+
+    // Converts count values with the fixed point precision, valueScale is the depth unit of a depth input (0 for the configured
+    // unit). False before setCalibration() or when the precision is DISPARITY_FLOAT.
+    bool transform(const uint16_t *src, size_t count, uint16_t *dst, float valueScale = 0) {
+        auto table = fixedTable(valueScale);
+        if(!table) {
+            return false;
+        }
+        lookup(table->fixed(), src, count, dst);
+        return true;
+    }
+
+    // Converts count values with the float precision. False before setCalibration() or when the precision is
+    // DISPARITY_FIXED_POINT.
+    bool transform(const uint16_t *src, size_t count, float *dst, float valueScale = 0) {
+        auto table = currentTable(valueScale);
+        if(!table || table->precision() != DISPARITY_FLOAT) {
+            return false;
+        }
+        lookup(table->values(), src, count, dst);
+        return true;
+    }
+
+    // Table of the current parameters, nullptr before setCalibration()
+    std::shared_ptr<const DisparityTable> table(float valueScale = 0) {
+        return currentTable(valueScale);
+    }
+
+private:
+    struct Params {
+        float              focalBaseline;  // millimeter pixels
+        float              depthUnit;
+        uint32_t           fractionBits;
+        DisparityPrecision precision;
+    };
+
+    bool                      depthToDisparity_;
+    std::shared_ptr<Executor> executor_;
+    bool                      enabled_;
+    std::mutex                paramsMutex_;
+    Params                    params_;
+
+    std::shared_ptr<const DisparityTable> currentTable(float valueScale) {
+        Params params;
+        {
+            std::lock_guard<std::mutex> lock(paramsMutex_);
+            params = params_;
+        }
+        if(params.focalBaseline <= 0) {
+            return nullptr;
+        }
+        // The depth input is read in its value scale, the depth output is written in the depth unit
+        float depthUnit = depthToDisparity_ && valueScale > 0 ? valueScale : params.depthUnit;
+        return disparityTableCache().get(params.focalBaseline, depthUnit, params.fractionBits, params.precision);
+    }
+
+    std::shared_ptr<const DisparityTable> fixedTable(float valueScale) {
+        auto table = currentTable(valueScale);
+        return table && table->precision() == DISPARITY_FIXED_POINT ? table : nullptr;
+    }
+
+    // Direct indexing, the 128 KB fixed point table stays in the L2 cache. Chunks of the image run on the executor.
+    template <typename T> void lookup(const T *table, const uint16_t *src, size_t count, T *dst) const {
+        auto body = [table, src, dst](size_t begin, size_t end) {
+            for(size_t i = begin; i < end; i++) {
+                dst[i] = table[src[i]];
+            }
+        };
+        if(!executor_) {
+            body(0, count);
+            return;
+        }
+        parallelFor(*executor_, 0, count, 65536, body);
+    }
+};
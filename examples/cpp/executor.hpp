@@ -0,0 +1,363 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs the host side processing tasks (filters, frame processing stages, parallel loops) of the application.
+//
+// The helpers of the examples never create processing threads of their own, they submit their work to an Executor so that
+// a process running many pipelines keeps a single pool sized to the machine. Install the application pool (TBB, a game
+// engine job system, ...) with setDefaultExecutor(), or use the built-in WorkStealingExecutor.
+// Tasks must not throw.
+class Executor {
+public:
+    typedef std::function<void()> Task;
+
+    virtual ~Executor() {}
+
+    virtual void submit(Task task) = 0;
+
+    // Number of tasks the executor can run at the same time, used to split parallel work
+    virtual size_t parallelism() const = 0;
+};
+
+// Runs every task on the submitting thread
+class InlineExecutor : public Executor {
+public:
+    void submit(Task task) override {
+        task();
+    }
+
+    size_t parallelism() const override {
+        return 1;
+    }
+};
+
+// Thread pool where each worker has its own task deque.
+// Tasks submitted from a worker go to the back of its own deque and are run last in first out, which keeps the data of
+// nested work in cache. Tasks submitted from other threads are spread over the workers. An idle worker steals from the
+// front of the other deques.
+class WorkStealingExecutor : public Executor {
+public:
+    // threadCount = 0: one worker per hardware thread
+    explicit WorkStealingExecutor(size_t threadCount = 0) : pending_(0), nextWorker_(0), stop_(false) {
+        if(threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for(size_t i = 0; i < threadCount; i++) {
+            workers_.emplace_back(new Worker());
+        }
+        for(size_t i = 0; i < threadCount; i++) {
+            threads_.emplace_back(&WorkStealingExecutor::run, this, i);
+        }
+    }
+
+    // The tasks already submitted are run before the workers exit
+    ~WorkStealingExecutor() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            stop_ = true;
+        }
+        sleepCv_.notify_all();
+        for(auto &thread: threads_) {
+            thread.join();
+        }
+    }
+
+    void submit(Task task) override {
+        size_t index = (current().executor == this) ? current().index : nextWorker_++ % workers_.size();
+        {
+            std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+            workers_[index]->tasks.push_back(std::move(task));
+        }
+        pending_++;
+        {
+            // Taking the lock orders the notification after the predicate check of a worker going to sleep
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+        }
+        sleepCv_.notify_one();
+    }
+
+    size_t parallelism() const override {
+        return workers_.size();
+    }
+
+private:
+    struct Worker {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+    };
+
+    struct CurrentWorker {
+        const WorkStealingExecutor *executor;
+        size_t                      index;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread>             threads_;
+    std::atomic<size_t>                  pending_;
+    std::atomic<size_t>                  nextWorker_;
+    std::mutex                           sleepMutex_;
+    std::condition_variable              sleepCv_;
+    bool                                 stop_;
+
+    static CurrentWorker &current() {
+        static thread_local CurrentWorker worker = { nullptr, 0 };
+        return worker;
+    }
+
+    bool take(size_t index, Task &task) {
+        // Own tasks first, newest first
+        {
+            std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+            if(!workers_[index]->tasks.empty()) {
+                task = std::move(workers_[index]->tasks.back());
+                workers_[index]->tasks.pop_back();
+                return true;
+            }
+        }
+        // Then steal the oldest task of another worker
+        for(size_t i = 1; i < workers_.size(); i++) {
+            Worker                     &victim = *workers_[(index + i) % workers_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(size_t index) {
+        current().executor = this;
+        current().index    = index;
+
+        Task task;
+        while(true) {
+            if(take(index, task)) {
+                pending_--;
+                task();
+                task = nullptr;
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            sleepCv_.wait(lock, [this]() { return stop_ || pending_ > 0; });
+            if(stop_ && pending_ == 0) {
+                break;
+            }
+        }
+    }
+};
+
+// Process wide executor used by the helpers when no executor is given, a WorkStealingExecutor is created on first use.
+inline std::shared_ptr<Executor> defaultExecutor(std::shared_ptr<Executor> replacement = nullptr, bool replace = false) {
+    static std::mutex                mutex;
+    static std::shared_ptr<Executor> executor;
+    std::lock_guard<std::mutex>      lock(mutex);
+    if(replace) {
+        executor = replacement;
+    }
+    if(!executor) {
+        executor = std::make_shared<WorkStealingExecutor>();
+    }
+    return executor;
+}
+
+// Install the application executor, call it before creating the helpers that use the default executor
+inline void setDefaultExecutor(std::shared_ptr<Executor> executor) {
+    defaultExecutor(executor, true);
+}
+
+// Runs body(begin, end) over chunks of [begin, end) on the executor and returns when every chunk is done.
+// The calling thread processes chunks too, so the loop completes even when every worker of the executor is busy (or when it
+// is called from a task of the same executor).
+inline void parallelFor(Executor &executor, size_t begin, size_t end, size_t minChunk, const std::function<void(size_t, size_t)> &body) {
+    if(end <= begin) {
+        return;
+    }
+
+    size_t count      = end - begin;
+    size_t chunkCount = std::min(executor.parallelism() * 4, (count + std::max<size_t>(minChunk, 1) - 1) / std::max<size_t>(minChunk, 1));
+    if(chunkCount <= 1) {
+        body(begin, end);
+        return;
+    }
+
+    struct Loop {
+        std::atomic<size_t>                       next;
+        std::atomic<size_t>                       done;
+        size_t                                    chunkCount;
+        size_t                                    begin;
+        size_t                                    count;
+        const std::function<void(size_t, size_t)> *body;
+        std::mutex                                mutex;
+        std::condition_variable                   doneCv;
+
+        // Claim and process chunks until there is none left
+        void work() {
+            size_t chunk;
+            while((chunk = next++) < chunkCount) {
+                (*body)(begin + count * chunk / chunkCount, begin + count * (chunk + 1) / chunkCount);
+                if(++done == chunkCount) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    doneCv.notify_all();
+                }
+            }
+        }
+    };
+
+    auto loop        = std::make_shared<Loop>();
+    loop->next       = 0;
+    loop->done       = 0;
+    loop->chunkCount = chunkCount;
+    loop->begin      = begin;
+    loop->count      = count;
+    loop->body       = &body;
+
+    // body stays valid for the helpers: the caller does not return before every claimed chunk is done, and the helpers
+    // starting later find no chunk left
+    size_t helpers = std::min(executor.parallelism(), chunkCount) - 1;
+    for(size_t i = 0; i < helpers; i++) {
+        executor.submit([loop]() { loop->work(); });
+    }
+    loop->work();
+
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->doneCv.wait(lock, [&loop]() { return loop->done == loop->chunkCount; });
+}
+
+// Runs tasks on an executor one at a time in submission order, for state that must not be accessed concurrently (a
+// stateful filter, a file writer, ...). A strand occupies no thread while it has nothing to run.
+class Strand {
+public:
+    explicit Strand(std::shared_ptr<Executor> executor = defaultExecutor()) : state_(std::make_shared<State>()) {
+        state_->executor = executor;
+        state_->running  = false;
+    }
+
+    void post(Executor::Task task) {
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            state_->tasks.push_back(std::move(task));
+            if(state_->running) {
+                return;
+            }
+            state_->running = true;
+        }
+        std::shared_ptr<State> state = state_;
+        state_->executor->submit([state]() { state->drain(); });
+    }
+
+    std::shared_ptr<Executor> executor() const {
+        return state_->executor;
+    }
+
+private:
+    struct State {
+        std::shared_ptr<Executor>  executor;
+        std::mutex                 mutex;
+        std::deque<Executor::Task> tasks;
+        bool                       running;
+
+        void drain() {
+            while(true) {
+                Executor::Task task;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(tasks.empty()) {
+                        running = false;
+                        return;
+                    }
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+    };
+
+    std::shared_ptr<State> state_;
+};
+
+// Asynchronous ob::Filter running on an executor instead of a thread created by the SDK.
+// pushFrame() returns immediately, frames are processed in push order and the result is passed to the callback.
+class ExecutorFilter {
+public:
+    explicit ExecutorFilter(std::shared_ptr<ob::Filter> filter, std::shared_ptr<Executor> executor = defaultExecutor())
+        : filter_(filter), strand_(executor), state_(std::make_shared<State>()) {}
+
+    void setCallBack(ob::FilterCallback callback) {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->callback = callback;
+    }
+
+    void pushFrame(std::shared_ptr<ob::Frame> frame) {
+        std::shared_ptr<ob::Filter> filter = filter_;
+        std::shared_ptr<State>      state  = state_;
+        strand_.post([filter, state, frame]() {
+            // Executor tasks must not throw, whatever the filter or the callback throws is counted and dropped
+            try {
+                auto result = filter->isEnabled() ? filter->process(frame) : frame;
+
+                ob::FilterCallback callback;
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    callback = state->callback;
+                }
+                if(callback && result) {
+                    callback(result);
+                }
+            }
+            catch(ob::Error &) {
+                state->errors++;
+            }
+            catch(std::exception &) {
+                state->errors++;
+            }
+            catch(...) {
+                state->errors++;
+            }
+        });
+    }
+
+    // Wait until the frames pushed so far are processed and passed to the callback. Flush the filters of a chain in order.
+    void flush() {
+        auto done = std::make_shared<std::promise<void>>();
+        strand_.post([done]() { done->set_value(); });
+        done->get_future().wait();
+    }
+
+    std::shared_ptr<ob::Filter> filter() const {
+        return filter_;
+    }
+
+    // Number of frames the filter failed to process (they are not passed to the callback) or the callback threw on
+    uint64_t errorCount() const {
+        return state_->errors;
+    }
+
+private:
+    struct State {
+        std::mutex            mutex;
+        ob::FilterCallback    callback;
+        std::atomic<uint64_t> errors{ 0 };
+    };
+
+    std::shared_ptr<ob::Filter> filter_;
+    Strand                      strand_;
+    std::shared_ptr<State>      state_;
+};
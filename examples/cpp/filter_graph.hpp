@@ -0,0 +1,280 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+#include "executor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Observed state of one stage of a FilterGraph
+struct FilterNodeStats {
+    std::string name;
+    size_t      queueDepth;     // frames waiting for the stage now
+    size_t      maxQueueDepth;  // highest queue depth seen
+    uint64_t    processed;      // frames processed by the stage
+    uint64_t    dropped;        // frames dropped because the queue of the stage was full
+    uint64_t    errors;         // frames the stage failed to process (any exception)
+    double      avgProcessMs;   // average processing time of a frame
+    double      lastProcessMs;  // processing time of the last frame
+    double      avgWaitMs;      // average time a frame waited in the queue of the stage
+};
+
+// Chain of filters processing frames concurrently across frames.
+//
+// Each stage has a bounded input queue and processes its frames one at a time, in order, on the executor. Different stages
+// run at the same time on different frames: while a stage works on frame N, the previous stage already works on frame N+1,
+// so the throughput is bounded by the slowest stage instead of the sum of all stages. Frames leave the graph in push order.
+// When the queue of a stage is full its oldest frame is dropped, which bounds the latency when the filters can not keep up.
+//
+// Add the stages before pushing the first frame.
+class FilterGraph {
+public:
+    typedef std::function<std::shared_ptr<ob::Frame>(std::shared_ptr<ob::Frame>)> Process;
+
+    explicit FilterGraph(std::shared_ptr<Executor> executor = defaultExecutor()) : state_(std::make_shared<State>()) {
+        state_->executor = executor;
+    }
+
+    // Wait for the frames in flight, the callback may use objects that are destroyed with the graph
+    ~FilterGraph() {
+        flush();
+    }
+
+    // Add a stage running a SDK filter, the stage passes the frames through while the filter is disabled
+    FilterGraph &addFilter(std::shared_ptr<ob::Filter> filter, size_t queueSize = 2) {
+        return addStage(filter->type(), [filter](std::shared_ptr<ob::Frame> frame) { return filter->isEnabled() ? filter->process(frame) : frame; },
+                        queueSize);
+    }
+
+    // Add a stage running any frame processing, returning nullptr drops the frame
+    FilterGraph &addStage(const std::string &name, Process process, size_t queueSize = 2) {
+        std::shared_ptr<Node> node = std::make_shared<Node>();
+        node->name                 = name;
+        node->process              = process;
+        node->capacity             = queueSize > 0 ? queueSize : 1;
+        state_->nodes.push_back(node);
+        return *this;
+    }
+
+    // Called with the output frames of the last stage, in push order, on an executor thread
+    void setCallBack(ob::FilterCallback callback) {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->callback = callback;
+    }
+
+    // Queue a frame at the first stage, returns immediately
+    void pushFrame(std::shared_ptr<ob::Frame> frame) {
+        if(frame == nullptr) {
+            return;
+        }
+        if(state_->nodes.empty()) {
+            state_->deliver(frame);
+            return;
+        }
+        state_->inFlight++;
+        state_->push(0, frame);
+    }
+
+    // Wait until every pushed frame left the graph
+    void flush() {
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        state_->idleCv.wait(lock, [this]() { return state_->inFlight == 0; });
+    }
+
+    size_t stageCount() const {
+        return state_->nodes.size();
+    }
+
+    FilterNodeStats stats(size_t stage) const {
+        Node           &node = *state_->nodes.at(stage);
+        FilterNodeStats stats;
+        std::lock_guard<std::mutex> lock(node.mutex);
+        stats.name          = node.name;
+        stats.queueDepth    = node.queue.size();
+        stats.maxQueueDepth = node.maxDepth;
+        stats.processed     = node.processed;
+        stats.dropped       = node.dropped;
+        stats.errors        = node.errors;
+        stats.avgProcessMs  = node.processed > 0 ? node.totalProcessUs / 1000.0 / node.processed : 0;
+        stats.lastProcessMs = node.lastProcessUs / 1000.0;
+        stats.avgWaitMs     = node.processed > 0 ? node.totalWaitUs / 1000.0 / node.processed : 0;
+        return stats;
+    }
+
+    std::vector<FilterNodeStats> stats() const {
+        std::vector<FilterNodeStats> result;
+        for(size_t i = 0; i < state_->nodes.size(); i++) {
+            result.push_back(stats(i));
+        }
+        return result;
+    }
+
+    // Frames whose callback threw, the graph keeps running
+    uint64_t callbackErrorCount() const {
+        return state_->callbackErrors;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Item {
+        std::shared_ptr<ob::Frame> frame;
+        Clock::time_point          queued;
+    };
+
+    struct Node {
+        std::string        name;
+        Process            process;
+        size_t             capacity;
+        mutable std::mutex mutex;
+        std::deque<Item>   queue;
+        bool               scheduled      = false;
+        size_t             maxDepth       = 0;
+        uint64_t           processed      = 0;
+        uint64_t           dropped        = 0;
+        uint64_t           errors         = 0;
+        uint64_t           totalProcessUs = 0;
+        uint64_t           lastProcessUs  = 0;
+        uint64_t           totalWaitUs    = 0;
+    };
+
+    struct State : std::enable_shared_from_this<State> {
+        std::shared_ptr<Executor>          executor;
+        std::vector<std::shared_ptr<Node>> nodes;
+        std::mutex                         mutex;
+        std::condition_variable            idleCv;
+        ob::FilterCallback                 callback;
+        std::atomic<size_t>                inFlight{ 0 };
+        std::atomic<uint64_t>              callbackErrors{ 0 };
+
+        void push(size_t index, std::shared_ptr<ob::Frame> frame) {
+            Node &node     = *nodes[index];
+            bool  schedule = false;
+            bool  dropped  = false;
+            {
+                std::lock_guard<std::mutex> lock(node.mutex);
+                if(node.queue.size() >= node.capacity) {
+                    node.queue.pop_front();
+                    node.dropped++;
+                    dropped = true;
+                }
+                node.queue.push_back({ frame, Clock::now() });
+                node.maxDepth = std::max(node.maxDepth, node.queue.size());
+                if(!node.scheduled) {
+                    node.scheduled = true;
+                    schedule       = true;
+                }
+            }
+            if(dropped) {
+                leave();
+            }
+            if(schedule) {
+                scheduleNode(index);
+            }
+        }
+
+        void scheduleNode(size_t index) {
+            std::shared_ptr<State> self = shared_from_this();
+            executor->submit([self, index]() { self->runNode(index); });
+        }
+
+        // Process one frame, then give the executor back so the other stages and applications get their turn
+        void runNode(size_t index) {
+            Node &node = *nodes[index];
+            Item  item;
+            {
+                std::lock_guard<std::mutex> lock(node.mutex);
+                item = node.queue.front();
+                node.queue.pop_front();
+            }
+
+            auto                       start = Clock::now();
+            std::shared_ptr<ob::Frame> result;
+            bool                       failed = false;
+            // Executor tasks must not throw, whatever the stage throws is counted in its errors
+            try {
+                result = node.process(item.frame);
+            }
+            catch(ob::Error &) {
+                failed = true;
+            }
+            catch(std::exception &) {
+                failed = true;
+            }
+            catch(...) {
+                failed = true;
+            }
+            auto end = Clock::now();
+            item.frame.reset();
+
+            {
+                std::lock_guard<std::mutex> lock(node.mutex);
+                uint64_t                    processUs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+                node.processed++;
+                node.errors += failed ? 1 : 0;
+                node.lastProcessUs = processUs;
+                node.totalProcessUs += processUs;
+                node.totalWaitUs += std::chrono::duration_cast<std::chrono::microseconds>(start - item.queued).count();
+            }
+
+            // The stage stays scheduled until the frame is handed over, so the next stage receives the frames in order
+            if(result == nullptr) {
+                leave();
+            }
+            else if(index + 1 < nodes.size()) {
+                push(index + 1, result);
+            }
+            else {
+                deliver(result);
+                leave();
+            }
+
+            bool more = false;
+            {
+                std::lock_guard<std::mutex> lock(node.mutex);
+                more           = !node.queue.empty();
+                node.scheduled = more;
+            }
+            if(more) {
+                scheduleNode(index);
+            }
+        }
+
+        void deliver(std::shared_ptr<ob::Frame> frame) {
+            ob::FilterCallback cb;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                cb = callback;
+            }
+            if(!cb) {
+                return;
+            }
+            // A throwing callback is counted, the graph keeps running. The graph may have no stages.
+            try {
+                cb(frame);
+            }
+            catch(...) {
+                callbackErrors++;
+            }
+        }
+
+        void leave() {
+            if(--inFlight == 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                idleCv.notify_all();
+            }
+        }
+    };
+
+    std::shared_ptr<State> state_;
+};
@@ -0,0 +1,265 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#endif
+
+// Scheduling of a frame delivery thread
+struct DeliveryThreadConfig {
+    std::string      name;       // thread name, at most 15 characters are used on Linux
+    std::vector<int> cpus;       // cores the thread is pinned to, empty: not pinned (not supported on macOS)
+    int              priority;   // real time priority, SCHED_FIFO 1-99 on Linux, > 0 means time critical on Windows; 0: normal scheduling
+    int              nice;       // nice value on Linux when priority is 0
+    size_t           queueSize;  // frames waiting for delivery, the oldest frame is dropped when the queue is full
+
+    DeliveryThreadConfig() : priority(0), nice(0), queueSize(4) {}
+};
+
+// Apply the name, affinity and scheduling of config to the calling thread.
+// Returns false and describes the refused settings in error if a setting could not be applied, e.g. SCHED_FIFO without the
+// CAP_SYS_NICE capability. The other settings are still applied.
+inline bool applyThreadConfig(const DeliveryThreadConfig &config, std::string &error) {
+    error.clear();
+#if defined(_WIN32)
+    if(!config.cpus.empty()) {
+        DWORD_PTR mask = 0;
+        for(int cpu: config.cpus) {
+            mask |= static_cast<DWORD_PTR>(1) << cpu;
+        }
+        if(SetThreadAffinityMask(GetCurrentThread(), mask) == 0) {
+            error += "affinity ";
+        }
+    }
+    if(config.priority > 0 && !SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) {
+        error += "priority ";
+    }
+#elif defined(__linux__)
+    if(!config.name.empty()) {
+        pthread_setname_np(pthread_self(), config.name.substr(0, 15).c_str());
+    }
+    if(!config.cpus.empty()) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        for(int cpu: config.cpus) {
+            CPU_SET(cpu, &cpuSet);
+        }
+        if(pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0) {
+            error += "affinity ";
+        }
+    }
+    if(config.priority > 0) {
+        sched_param param;
+        param.sched_priority = config.priority;
+        if(pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+            error += "priority ";
+        }
+    }
+    else if(config.nice != 0) {
+        // The nice value is per thread on Linux
+        if(setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), config.nice) != 0) {
+            error += "nice ";
+        }
+    }
+#elif defined(__APPLE__)
+    if(!config.name.empty()) {
+        pthread_setname_np(config.name.c_str());
+    }
+    if(!config.cpus.empty()) {
+        error += "affinity ";
+    }
+    if(config.priority > 0) {
+        sched_param param;
+        param.sched_priority = config.priority;
+        if(pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+            error += "priority ";
+        }
+    }
+#endif
+    return error.empty();
+}
+
+// Application owned thread delivering frames to a callback.
+//
+// The SDK calls the frame callbacks on its own threads, whose number, placement and scheduling can not be configured.
+// push() only queues the frame and returns, the callback runs on this thread with the name, affinity and priority of its
+// DeliveryThreadConfig. When the callback falls behind, the oldest queued frame is dropped so the latency stays bounded.
+class FrameDeliveryThread {
+public:
+    FrameDeliveryThread(const DeliveryThreadConfig &config, ob::FrameCallback callback)
+        : config_(config), callback_(callback), stop_(false), started_(false), delivered_(0), dropped_(0), configApplied_(false) {
+        if(config_.queueSize == 0) {
+            config_.queueSize = 1;
+        }
+        thread_ = std::thread(&FrameDeliveryThread::run, this);
+
+        // Report the outcome of the configuration to the creator
+        std::unique_lock<std::mutex> lock(mutex_);
+        startedCv_.wait(lock, [this]() { return started_; });
+    }
+
+    // Queued frames that were not delivered yet are released
+    ~FrameDeliveryThread() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        frameCv_.notify_all();
+        thread_.join();
+    }
+
+    // Queue a frame for delivery, never blocks on the callback
+    void push(std::shared_ptr<ob::Frame> frame) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(queue_.size() >= config_.queueSize) {
+                queue_.pop_front();
+                dropped_++;
+            }
+            queue_.push_back(frame);
+        }
+        frameCv_.notify_one();
+    }
+
+    const DeliveryThreadConfig &config() const {
+        return config_;
+    }
+
+    // false if some settings of the configuration were refused by the system, see configError()
+    bool configApplied() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return configApplied_;
+    }
+
+    std::string configError() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return configError_;
+    }
+
+    uint64_t deliveredCount() const {
+        return delivered_;
+    }
+
+    uint64_t droppedCount() const {
+        return dropped_;
+    }
+
+private:
+    DeliveryThreadConfig                   config_;
+    ob::FrameCallback                      callback_;
+    std::deque<std::shared_ptr<ob::Frame>> queue_;
+    mutable std::mutex                     mutex_;
+    std::condition_variable                frameCv_;
+    std::condition_variable                startedCv_;
+    bool                                   stop_;
+    bool                                   started_;
+    std::atomic<uint64_t>                  delivered_;
+    std::atomic<uint64_t>                  dropped_;
+    bool                                   configApplied_;
+    std::string                            configError_;
+    std::thread                            thread_;
+
+    void run() {
+        std::string error;
+        bool        applied = applyThreadConfig(config_, error);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            configError_   = error;
+            configApplied_ = applied;
+            started_       = true;
+        }
+        startedCv_.notify_all();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(true) {
+            frameCv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+            if(stop_) {
+                break;
+            }
+
+            auto frame = queue_.front();
+            queue_.pop_front();
+            lock.unlock();
+            callback_(frame);
+            delivered_++;
+            frame.reset();
+            lock.lock();
+        }
+    }
+};
+
+// Routes the frames of each frame type to its delivery thread.
+// A delivery thread can serve several frame types, which sets the number of delivery threads. The routes must be set before
+// the stream is started, frames of a type without route are ignored.
+class StreamDelivery {
+public:
+    void route(OBFrameType type, std::shared_ptr<FrameDeliveryThread> thread) {
+        routes_[type] = thread;
+    }
+
+    void dispatch(std::shared_ptr<ob::Frame> frame) {
+        if(frame == nullptr) {
+            return;
+        }
+        if(frame->type() == OB_FRAME_SET) {
+            auto frameSet = frame->as<ob::FrameSet>();
+            for(uint32_t i = 0; i < frameSet->frameCount(); i++) {
+                dispatch(frameSet->getFrame(static_cast<int>(i)));
+            }
+            return;
+        }
+
+        auto iter = routes_.find(frame->type());
+        if(iter != routes_.end()) {
+            iter->second->push(frame);
+        }
+    }
+
+    // Callback for Pipeline::start(config, callback)
+    ob::FrameSetCallback frameSetCallback() {
+        return [this](std::shared_ptr<ob::FrameSet> frameSet) { dispatch(frameSet); };
+    }
+
+    // Callback for Sensor::start(profile, callback)
+    ob::FrameCallback frameCallback() {
+        return [this](std::shared_ptr<ob::Frame> frame) { dispatch(frame); };
+    }
+
+    // Delivery threads without duplicates
+    std::vector<std::shared_ptr<FrameDeliveryThread>> threads() const {
+        std::vector<std::shared_ptr<FrameDeliveryThread>> result;
+        for(auto &entry: routes_) {
+            bool found = false;
+            for(auto &thread: result) {
+                found = found || thread == entry.second;
+            }
+            if(!found) {
+                result.push_back(entry.second);
+            }
+        }
+        return result;
+    }
+
+private:
+    std::map<OBFrameType, std::shared_ptr<FrameDeliveryThread>> routes_;
+};
@@ -0,0 +1,151 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Hard ceiling for the frame memory held by the application.
+//
+// The SDK frame memory pool is bounded by <Memory><MaxFrameBufferSize> in the configuration file, but the pool can only
+// reuse a buffer after the application has released every reference to the frame. FrameMemoryBudget accounts the bytes
+// of every frame admitted through it until the last reference is dropped. When admitting a frame would exceed the
+// limit, the frame is dropped instead (and counted), so that frames queued by slow consumers cannot grow the process
+// memory without bound. One budget is meant to be shared by all the pipelines created from the same ob::Context.
+//
+// The bytes are released with the pointer returned by admit() and its copies only. Frame::as<>() goes through
+// shared_from_this() to the original frame, so the pointers it returns, like the frames taken out of an admitted frame set
+// with getFrame() or colorFrame(), keep the memory after the budget released it. Keep only copies of the admitted pointer
+// and use as<>() for the time of a call, and admit the frames of a frame set with admitFrames() to account each of them.
+class FrameMemoryBudget {
+public:
+    // Called when the budget starts dropping frames: in-use bytes, limit bytes and total dropped frame count.
+    // It is called again only after the in-use memory fell back under the limit and the limit is reached once more.
+    typedef std::function<void(uint64_t inUseBytes, uint64_t limitBytes, uint64_t droppedCount)> BudgetExceededCallback;
+
+    // limitBytes = 0 means unlimited, the budget only counts the memory in use.
+    explicit FrameMemoryBudget(uint64_t limitBytes = 0) : state_(std::make_shared<State>()) {
+        state_->limit = limitBytes;
+    }
+
+    // The limit can be changed at runtime, frames already admitted are not affected.
+    void setLimit(uint64_t limitBytes) {
+        state_->limit = limitBytes;
+    }
+
+    uint64_t limit() const {
+        return state_->limit;
+    }
+
+    uint64_t inUse() const {
+        return state_->inUse;
+    }
+
+    uint64_t droppedCount() const {
+        return state_->dropped;
+    }
+
+    void setBudgetExceededCallback(BudgetExceededCallback callback) {
+        std::lock_guard<std::mutex> lock(state_->callbackMutex);
+        state_->callback = callback;
+    }
+
+    // Admit a frame into the budget.
+    // Returns a reference to the same frame whose bytes are released from the budget when the returned pointer (and all its
+    // copies) are destroyed, or nullptr if the frame was dropped because the limit would be exceeded.
+    template <typename T> std::shared_ptr<T> admit(std::shared_ptr<T> frame) {
+        if(frame == nullptr) {
+            return nullptr;
+        }
+
+        uint64_t size = frameSize(frame);
+        if(!state_->reserve(size)) {
+            state_->onDropped();
+            return nullptr;
+        }
+
+        std::shared_ptr<State> state = state_;
+        return std::shared_ptr<T>(frame.get(), [state, frame, size](T *) { state->release(size); });
+    }
+
+    // Admit each frame of a frame set on its own, result[i] is frame i or nullptr when it was dropped (or is missing)
+    std::vector<std::shared_ptr<ob::Frame>> admitFrames(std::shared_ptr<ob::FrameSet> frameSet) {
+        std::vector<std::shared_ptr<ob::Frame>> frames;
+        if(frameSet == nullptr) {
+            return frames;
+        }
+        for(uint32_t i = 0; i < frameSet->frameCount(); i++) {
+            frames.push_back(admit(frameSet->getFrame(static_cast<int>(i))));
+        }
+        return frames;
+    }
+
+private:
+    struct State {
+        std::atomic<uint64_t>  limit{ 0 };
+        std::atomic<uint64_t>  inUse{ 0 };
+        std::atomic<uint64_t>  dropped{ 0 };
+        std::atomic<bool>      exceeded{ false };
+        std::mutex             callbackMutex;
+        BudgetExceededCallback callback;
+
+        bool reserve(uint64_t size) {
+            uint64_t current = inUse.load();
+            do {
+                uint64_t max = limit.load();
+                if(max != 0 && current + size > max) {
+                    return false;
+                }
+            } while(!inUse.compare_exchange_weak(current, current + size));
+            return true;
+        }
+
+        void release(uint64_t size) {
+            uint64_t remaining = inUse.fetch_sub(size) - size;
+            uint64_t max       = limit.load();
+            if(max == 0 || remaining < max) {
+                exceeded = false;
+            }
+        }
+
+        void onDropped() {
+            uint64_t count = ++dropped;
+            if(exceeded.exchange(true)) {
+                return;
+            }
+
+            BudgetExceededCallback cb;
+            {
+                std::lock_guard<std::mutex> lock(callbackMutex);
+                cb = callback;
+            }
+            if(cb) {
+                cb(inUse.load(), limit.load(), count);
+            }
+        }
+    };
+
+    template <typename T> static uint64_t frameSize(std::shared_ptr<T> &frame) {
+        if(frame->type() != OB_FRAME_SET) {
+            return frame->dataSize();
+        }
+
+        // The frame set does not own the frame data, account for the frames it contains
+        uint64_t size     = 0;
+        auto     frameSet = std::static_pointer_cast<ob::Frame>(frame)->template as<ob::FrameSet>();
+        for(uint32_t i = 0; i < frameSet->frameCount(); i++) {
+            auto subFrame = frameSet->getFrame(static_cast<int>(i));
+            if(subFrame) {
+                size += subFrame->dataSize();
+            }
+        }
+        return size;
+    }
+
+    std::shared_ptr<State> state_;
+};
@@ -0,0 +1,216 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+#include "executor.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Counters of a HostHdrMerge
+struct HdrMergeStats {
+    uint64_t merged;           // frames emitted, one per pair
+    uint64_t unpaired;         // frames dropped without a frame of the other sequence next to them
+    uint64_t passedThrough;    // depth frames without HDR sequence index, returned unchanged
+    uint64_t framesAllocated;  // output frames created, the others reused a released output frame
+};
+
+// Host side HDR merge of Y16 depth frames alternating between the two exposures of OB_STRUCT_DEPTH_HDR_CONFIG.
+//
+// Frames are paired as they arrive: the first frame of a pair is held, and the merged frame is returned by process() as
+// soon as the frame of the other sequence with the next frame index arrives, so the output lags the second exposure by the
+// merge only. A held frame followed by a frame of the same sequence, or by a gap in the frame indices, is counted unpaired.
+// Each pixel takes the depth of the primary sequence when it is valid, else the depth of the other sequence. With
+// setMaxDifference() the pixels where both depths are valid and close are averaged instead. The blend runs 8 pixels at a
+// time with SSE2 or NEON, split over the executor given at construction.
+// The output frames come from a small pool and are reused once the application releases every std::shared_ptr to them
+// (including the ones returned by as<>()). The pool can not see the references the SDK takes on the frame handle, so an output
+// frame must not be kept by the SDK past its last std::shared_ptr (e.g. added to a frame set, recorded or queued in a
+// filter): copy it first, or construct the merge with poolSize 0 to get a new frame each time. Like the other host filters,
+// the output frames do not carry the value scale of the stream.
+class HostHdrMerge {
+public:
+    explicit HostHdrMerge(std::shared_ptr<Executor> executor = nullptr, size_t poolSize = 3)
+        : executor_(executor), poolSize_(poolSize), primarySequence_(0), maxDifference_(0), pendingSequence_(0) {
+        memset(&stats_, 0, sizeof(stats_));
+    }
+
+    const char *type() const {
+        return "HostHdrMerge";
+    }
+
+    // Sequence index whose depth is kept first, 0 for the exposure_1/gain_1 of OBHdrConfig
+    void setPrimarySequence(uint32_t sequence) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        primarySequence_ = sequence;
+    }
+
+    // Valid depths of both exposures within maxDifference millimeters are averaged, 0 keeps the primary depth
+    void setMaxDifference(uint16_t maxDifference) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        maxDifference_ = maxDifference;
+    }
+
+    // Merged frame, nullptr while the first frame of a pair is held. Frames other than Y16 depth are returned unchanged.
+    std::shared_ptr<ob::Frame> process(std::shared_ptr<ob::Frame> frame) {
+        if(frame == nullptr || frame->type() != OB_FRAME_DEPTH || frame->format() != OB_FORMAT_Y16) {
+            return frame;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(!frame->hasMetadata(OB_FRAME_METADATA_TYPE_HDR_SEQUENCE_INDEX)) {
+            stats_.passedThrough++;
+            return frame;
+        }
+        uint32_t sequence   = static_cast<uint32_t>(frame->getMetadataValue(OB_FRAME_METADATA_TYPE_HDR_SEQUENCE_INDEX));
+        auto     depthFrame = frame->as<ob::DepthFrame>();
+        uint32_t width      = depthFrame->width();
+        uint32_t height     = depthFrame->height();
+        size_t   count      = static_cast<size_t>(width) * height;
+        if(frame->dataSize() < count * sizeof(uint16_t)) {
+            return frame;
+        }
+        if(!pending_ || pendingSequence_ == sequence || frame->index() != pending_->index() + 1 || pending_->width() != width
+           || pending_->height() != height) {
+            if(pending_) {
+                stats_.unpaired++;
+            }
+            pending_         = depthFrame;
+            pendingSequence_ = sequence;
+            return nullptr;
+        }
+
+        auto first = pending_;
+        pending_.reset();
+        stats_.merged++;
+        const uint16_t *primary   = reinterpret_cast<const uint16_t *>(first->data());
+        const uint16_t *secondary = reinterpret_cast<const uint16_t *>(frame->data());
+        if(sequence == primarySequence_) {
+            std::swap(primary, secondary);
+        }
+        float     valueScale = depthFrame->getValueScale() > 0 ? depthFrame->getValueScale() : 1.0f;
+        uint16_t  difference = static_cast<uint16_t>(std::min(65535.0f, std::floor(maxDifference_ / valueScale)));
+        bool      average    = maxDifference_ > 0;
+        auto      output     = acquireFrame(width, height);
+        uint16_t *dst        = reinterpret_cast<uint16_t *>(output->data());
+        lock.unlock();
+
+        ob::FrameHelper::setFrameDeviceTimestampUs(output, frame->timeStampUs());
+        ob::FrameHelper::setFrameSystemTimestamp(output, frame->systemTimeStamp());
+        if(!executor_) {
+            blend(primary, secondary, average, difference, count, dst);
+            return output;
+        }
+        parallelFor(*executor_, 0, count, 65536, [=](size_t begin, size_t end) {
+            blend(primary + begin, secondary + begin, average, difference, end - begin, dst + begin);
+        });
+        return output;
+    }
+
+    // Drop the held frame, e.g. when the HDR configuration changes
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(pending_) {
+            stats_.unpaired++;
+            pending_.reset();
+        }
+    }
+
+    HdrMergeStats stats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    // Per pixel merge of count depths, exposed for benchmarks
+    static void blend(const uint16_t *primary, const uint16_t *secondary, bool average, uint16_t maxDifference, size_t count, uint16_t *dst) {
+        size_t i = 0;
+#if defined(OB_EXAMPLES_SSE2)
+        const __m128i zero      = _mm_setzero_si128();
+        const __m128i threshold = _mm_set1_epi16(static_cast<short>(maxDifference));
+        const __m128i averaged  = average ? _mm_set1_epi16(-1) : zero;
+        for(; i + 8 <= count; i += 8) {
+            __m128i a          = _mm_loadu_si128(reinterpret_cast<const __m128i *>(primary + i));
+            __m128i b          = _mm_loadu_si128(reinterpret_cast<const __m128i *>(secondary + i));
+            __m128i aInvalid   = _mm_cmpeq_epi16(a, zero);
+            __m128i bInvalid   = _mm_cmpeq_epi16(b, zero);
+            __m128i selected   = _mm_or_si128(_mm_andnot_si128(aInvalid, a), _mm_and_si128(aInvalid, b));
+            __m128i distance   = _mm_or_si128(_mm_subs_epu16(a, b), _mm_subs_epu16(b, a));
+            __m128i close      = _mm_cmpeq_epi16(_mm_subs_epu16(distance, threshold), zero);
+            __m128i useAverage = _mm_andnot_si128(_mm_or_si128(aInvalid, bInvalid), _mm_and_si128(close, averaged));
+            __m128i result     = _mm_or_si128(_mm_andnot_si128(useAverage, selected), _mm_and_si128(useAverage, _mm_avg_epu16(a, b)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), result);
+        }
+#elif defined(OB_EXAMPLES_NEON)
+        const uint16x8_t zero      = vdupq_n_u16(0);
+        const uint16x8_t threshold = vdupq_n_u16(maxDifference);
+        const uint16x8_t averaged  = vdupq_n_u16(average ? 0xffff : 0);
+        for(; i + 8 <= count; i += 8) {
+            uint16x8_t a          = vld1q_u16(primary + i);
+            uint16x8_t b          = vld1q_u16(secondary + i);
+            uint16x8_t aInvalid   = vceqq_u16(a, zero);
+            uint16x8_t bInvalid   = vceqq_u16(b, zero);
+            uint16x8_t selected   = vbslq_u16(aInvalid, b, a);
+            uint16x8_t close      = vcleq_u16(vabdq_u16(a, b), threshold);
+            uint16x8_t useAverage = vbicq_u16(vandq_u16(close, averaged), vorrq_u16(aInvalid, bInvalid));
+            vst1q_u16(dst + i, vbslq_u16(useAverage, vrhaddq_u16(a, b), selected));
+        }
+#endif
+        for(; i < count; i++) {
+            uint16_t a = primary[i];
+            uint16_t b = secondary[i];
+            if(a == 0) {
+                dst[i] = b;
+            }
+            else if(average && b != 0 && std::abs(a - b) <= maxDifference) {
+                dst[i] = static_cast<uint16_t>((a + b + 1) >> 1);
+            }
+            else {
+                dst[i] = a;
+            }
+        }
+    }
+
+private:
+    std::shared_ptr<Executor>                    executor_;
+    size_t                                       poolSize_;
+    std::vector<std::shared_ptr<ob::DepthFrame>> pool_;
+    std::mutex                                   mutex_;
+    uint32_t                                     primarySequence_;
+    uint16_t                                     maxDifference_;  // millimeters
+    std::shared_ptr<ob::DepthFrame>              pending_;
+    uint32_t                                     pendingSequence_;
+    HdrMergeStats                                stats_;
+
+    // An output frame of the pool the application released (only the pool holds it), or a new one
+    std::shared_ptr<ob::Frame> acquireFrame(uint32_t width, uint32_t height) {
+        for(auto &frame: pool_) {
+            if(frame.use_count() == 1 && frame->width() == width && frame->height() == height) {
+                // The count only drops to 1 after the last reads of the application, which happen before the new merge
+                std::atomic_thread_fence(std::memory_order_acquire);
+                return frame;
+            }
+        }
+        auto frame = ob::FrameHelper::createFrame(OB_FRAME_DEPTH, OB_FORMAT_Y16, width, height, 0)->as<ob::DepthFrame>();
+        stats_.framesAllocated++;
+        if(pool_.size() < poolSize_) {
+            pool_.push_back(frame);
+        }
+        else {
+            // Replace a frame of another resolution, the application keeps it alive as long as it uses it
+            for(auto &pooled: pool_) {
+                if(pooled->width() != width || pooled->height() != height) {
+                    pooled = frame;
+                    break;
+                }
+            }
+        }
+        return frame;
+    }
+};
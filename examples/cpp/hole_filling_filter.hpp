@@ -0,0 +1,335 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "depth_filter.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+// Host side hole filling filter with a bounded fill radius and a cost per pixel independent of the size of the holes.
+//
+// Invalid pixels (depth 0) take a depth from the valid pixels around them:
+// - OB_HOLE_FILL_TOP: the closest valid pixel above, at most maxRadius rows up
+// - OB_HOLE_FILL_NEAREST: the nearest depth among the valid pixels at most maxRadius pixels away (square window)
+// - OB_HOLE_FILL_FAREST: the farthest depth among the valid pixels at most maxRadius pixels away (square window)
+// Pixels without valid pixel in reach stay invalid. The square windows are separable running min/max passes (van Herk /
+// Gil-Werman): a vertical pass over column bands, vectorized across the columns, then a horizontal pass over row bands.
+// Each pass costs 3 comparisons per pixel whatever the radius, so the runtime does not depend on the content of the frame.
+class HostHoleFillingFilter : public DepthFilter {
+public:
+    explicit HostHoleFillingFilter(std::shared_ptr<Executor> executor = nullptr) : DepthFilter(executor) {
+        params_.mode      = OB_HOLE_FILL_NEAREST;
+        params_.maxRadius = 4;
+    }
+
+    const char *type() const override {
+        return "HostHoleFillingFilter";
+    }
+
+    void setFilterMode(OBHoleFillingMode mode) {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        params_.mode = mode;
+    }
+
+    OBHoleFillingMode getFilterMode() {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        return params_.mode;
+    }
+
+    // Largest distance in pixels a depth is propagated into a hole, at least 1
+    void setMaxRadius(uint32_t radius) {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        params_.maxRadius = std::max(radius, 1u);
+    }
+
+    uint32_t getMaxRadius() {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        return params_.maxRadius;
+    }
+
+protected:
+    void loadParams() override {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        frameParams_ = params_;
+    }
+
+    uint32_t haloSize() const override {
+        return frameParams_.maxRadius;
+    }
+
+    void processImage(const DepthImage &image) override {
+        switch(frameParams_.mode) {
+        case OB_HOLE_FILL_TOP:
+            fillFromTop(image);
+            break;
+        case OB_HOLE_FILL_FAREST:
+            fillFromWindow<MaxOp>(image);
+            break;
+        default:
+            fillFromWindow<MinOp>(image);
+            break;
+        }
+    }
+
+private:
+    struct Params {
+        OBHoleFillingMode mode;
+        uint32_t          maxRadius;
+    };
+
+    // Largest valid depth, invalid pixels are 0 so they never win
+    struct MaxOp {
+        static uint16_t identity() {
+            return 0;
+        }
+
+        static uint16_t apply(uint16_t a, uint16_t b) {
+            return a > b ? a : b;
+        }
+
+        static uint16_t load(uint16_t value) {
+            return value;
+        }
+#if defined(OB_EXAMPLES_SSE2)
+        static __m128i apply(__m128i a, __m128i b) {
+            return _mm_add_epi16(_mm_subs_epu16(a, b), b);
+        }
+
+        static __m128i load(__m128i value) {
+            return value;
+        }
+#elif defined(OB_EXAMPLES_NEON)
+        static uint16x8_t apply(uint16x8_t a, uint16x8_t b) {
+            return vmaxq_u16(a, b);
+        }
+
+        static uint16x8_t load(uint16x8_t value) {
+            return value;
+        }
+#endif
+    };
+
+    // Smallest valid depth, invalid pixels are loaded as 0xffff so they never win
+    struct MinOp {
+        static uint16_t identity() {
+            return 0xffff;
+        }
+
+        static uint16_t apply(uint16_t a, uint16_t b) {
+            return a < b ? a : b;
+        }
+
+        static uint16_t load(uint16_t value) {
+            return value == 0 ? identity() : value;
+        }
+#if defined(OB_EXAMPLES_SSE2)
+        static __m128i apply(__m128i a, __m128i b) {
+            return _mm_sub_epi16(a, _mm_subs_epu16(a, b));
+        }
+
+        static __m128i load(__m128i value) {
+            return _mm_or_si128(value, _mm_cmpeq_epi16(value, _mm_setzero_si128()));
+        }
+#elif defined(OB_EXAMPLES_NEON)
+        static uint16x8_t apply(uint16x8_t a, uint16x8_t b) {
+            return vminq_u16(a, b);
+        }
+
+        static uint16x8_t load(uint16x8_t value) {
+            return vorrq_u16(value, vceqq_u16(value, vdupq_n_u16(0)));
+        }
+#endif
+    };
+
+    std::mutex            paramsMutex_;
+    Params                params_;
+    Params                frameParams_;
+    std::vector<uint16_t> prefix_;
+    std::vector<uint16_t> suffix_;
+
+    // out[i] = Op(a[i], b[i]) for i in [0, count)
+    template <typename Op> static void combine(const uint16_t *a, const uint16_t *b, uint16_t *out, uint32_t count) {
+        uint32_t i = 0;
+#if defined(OB_EXAMPLES_SSE2)
+        for(; i + 8 <= count; i += 8) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), Op::apply(va, vb));
+        }
+#elif defined(OB_EXAMPLES_NEON)
+        for(; i + 8 <= count; i += 8) {
+            vst1q_u16(out + i, Op::apply(vld1q_u16(a + i), vld1q_u16(b + i)));
+        }
+#endif
+        for(; i < count; i++) {
+            out[i] = Op::apply(a[i], b[i]);
+        }
+    }
+
+    // out[i] = Op::load(src[i]), or the identity when src is nullptr (rows outside the image)
+    template <typename Op> static void load(const uint16_t *src, uint16_t *out, uint32_t count) {
+        if(src == nullptr) {
+            std::fill(out, out + count, Op::identity());
+            return;
+        }
+        uint32_t i = 0;
+#if defined(OB_EXAMPLES_SSE2)
+        for(; i + 8 <= count; i += 8) {
+            __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), Op::load(value));
+        }
+#elif defined(OB_EXAMPLES_NEON)
+        for(; i + 8 <= count; i += 8) {
+            vst1q_u16(out + i, Op::load(vld1q_u16(src + i)));
+        }
+#endif
+        for(; i < count; i++) {
+            out[i] = Op::load(src[i]);
+        }
+    }
+
+    // Min/max over the (2 * radius + 1) square window around each pixel, then fill the holes with it
+    template <typename Op> void fillFromWindow(const DepthImage &image) {
+        const uint32_t width   = image.width;
+        const uint32_t height  = image.height;
+        const uint32_t radius  = frameParams_.maxRadius;
+        const uint32_t window  = 2 * radius + 1;
+        const uint32_t padded  = height + 2 * radius;  // rows of the image with radius rows of identity above and below
+        const size_t   padSize = static_cast<size_t>(padded) * width;
+        if(prefix_.size() < padSize) {
+            prefix_.resize(padSize);
+            suffix_.resize(padSize);
+        }
+        uint16_t *prefix = prefix_.data();
+        uint16_t *suffix = suffix_.data();
+
+        // Vertical pass: running Op over blocks of window rows from both ends, the window of padded rows [y, y + 2 * radius]
+        // is Op(suffix[y], prefix[y + 2 * radius]). The result is stored over suffix rows [0, height).
+        forEachBand(
+            width,
+            [&](uint32_t x0, uint32_t x1) {
+                const uint32_t count = x1 - x0;
+                for(uint32_t blockBegin = 0; blockBegin < padded; blockBegin += window) {
+                    uint32_t blockEnd = std::min(blockBegin + window, padded);
+                    for(uint32_t row = blockBegin; row < blockEnd; row++) {
+                        bool            inside = row >= radius && row < radius + height;
+                        const uint16_t *src    = inside ? image.src + static_cast<size_t>(row - radius) * image.stride + x0 : nullptr;
+                        uint16_t       *out    = prefix + static_cast<size_t>(row) * width + x0;
+                        load<Op>(src, out, count);
+                        if(row > blockBegin) {
+                            combine<Op>(out - width, out, out, count);
+                        }
+                    }
+                    for(uint32_t row = blockEnd; row-- > blockBegin;) {
+                        bool            inside = row >= radius && row < radius + height;
+                        const uint16_t *src    = inside ? image.src + static_cast<size_t>(row - radius) * image.stride + x0 : nullptr;
+                        uint16_t       *out    = suffix + static_cast<size_t>(row) * width + x0;
+                        load<Op>(src, out, count);
+                        if(row + 1 < blockEnd) {
+                            combine<Op>(out + width, out, out, count);
+                        }
+                    }
+                }
+                for(uint32_t y = 0; y < height; y++) {
+                    uint16_t *out = suffix + static_cast<size_t>(y) * width + x0;
+                    combine<Op>(out, prefix + static_cast<size_t>(y + 2 * radius) * width + x0, out, count);
+                }
+            },
+            64);
+
+        // Horizontal pass over the vertical result, with radius identity pixels on both sides of the row
+        forEachBand(image.height, [&](uint32_t y0, uint32_t y1) {
+            const uint32_t        paddedWidth = width + 2 * radius;
+            std::vector<uint16_t> line(paddedWidth, Op::identity());
+            std::vector<uint16_t> rowPrefix(paddedWidth);
+            std::vector<uint16_t> rowSuffix(paddedWidth);
+            for(uint32_t y = y0; y < y1; y++) {
+                const uint16_t *vertical = suffix + static_cast<size_t>(y) * width;
+                std::copy(vertical, vertical + width, line.begin() + radius);
+                for(uint32_t blockBegin = 0; blockBegin < paddedWidth; blockBegin += window) {
+                    uint32_t blockEnd     = std::min(blockBegin + window, paddedWidth);
+                    rowPrefix[blockBegin] = line[blockBegin];
+                    for(uint32_t x = blockBegin + 1; x < blockEnd; x++) {
+                        rowPrefix[x] = Op::apply(rowPrefix[x - 1], line[x]);
+                    }
+                    rowSuffix[blockEnd - 1] = line[blockEnd - 1];
+                    for(uint32_t x = blockEnd - 1; x-- > blockBegin;) {
+                        rowSuffix[x] = Op::apply(rowSuffix[x + 1], line[x]);
+                    }
+                }
+
+                const uint16_t *src = image.src + static_cast<size_t>(y) * image.stride;
+                uint16_t       *dst = image.dst + static_cast<size_t>(y) * image.stride;
+                for(uint32_t x = 0; x < width; x++) {
+                    uint16_t fill = Op::apply(rowSuffix[x], rowPrefix[x + 2 * radius]);
+                    dst[x]        = src[x] != 0 ? src[x] : (fill == Op::identity() ? 0 : fill);
+                }
+            }
+        });
+    }
+
+    // Carry the last valid depth of each column down, for at most maxRadius rows
+    void fillFromTop(const DepthImage &image) {
+        const uint32_t width  = image.width;
+        const uint16_t radius = static_cast<uint16_t>(std::min<uint32_t>(frameParams_.maxRadius, 0xfffe));
+        if(prefix_.size() < 2 * static_cast<size_t>(width)) {
+            prefix_.resize(2 * static_cast<size_t>(width));
+        }
+        uint16_t *last = prefix_.data();          // last valid depth of each column
+        uint16_t *age  = prefix_.data() + width;  // rows since that depth
+
+        forEachBand(
+            width,
+            [&](uint32_t x0, uint32_t x1) {
+                std::fill(last + x0, last + x1, static_cast<uint16_t>(0));
+                std::fill(age + x0, age + x1, static_cast<uint16_t>(0xffff));
+                for(uint32_t y = 0; y < image.height; y++) {
+                    const uint16_t *src = image.src + static_cast<size_t>(y) * image.stride;
+                    uint16_t       *dst = image.dst + static_cast<size_t>(y) * image.stride;
+                    uint32_t        x   = x0;
+#if defined(OB_EXAMPLES_SSE2)
+                    const __m128i zero    = _mm_setzero_si128();
+                    const __m128i one     = _mm_set1_epi16(1);
+                    const __m128i vRadius = _mm_set1_epi16(static_cast<short>(radius));
+                    for(; x + 8 <= x1; x += 8) {
+                        __m128i value   = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+                        __m128i invalid = _mm_cmpeq_epi16(value, zero);
+                        __m128i vLast   = _mm_loadu_si128(reinterpret_cast<const __m128i *>(last + x));
+                        __m128i vAge    = _mm_and_si128(_mm_adds_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(age + x)), one), invalid);
+                        vLast           = _mm_or_si128(_mm_and_si128(invalid, vLast), _mm_andnot_si128(invalid, value));
+                        __m128i reach   = _mm_cmpeq_epi16(_mm_subs_epu16(vAge, vRadius), zero);
+                        _mm_storeu_si128(reinterpret_cast<__m128i *>(last + x), vLast);
+                        _mm_storeu_si128(reinterpret_cast<__m128i *>(age + x), vAge);
+                        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_and_si128(vLast, reach));
+                    }
+#elif defined(OB_EXAMPLES_NEON)
+                    const uint16x8_t zero    = vdupq_n_u16(0);
+                    const uint16x8_t one     = vdupq_n_u16(1);
+                    const uint16x8_t vRadius = vdupq_n_u16(radius);
+                    for(; x + 8 <= x1; x += 8) {
+                        uint16x8_t value   = vld1q_u16(src + x);
+                        uint16x8_t invalid = vceqq_u16(value, zero);
+                        uint16x8_t vAge    = vandq_u16(vqaddq_u16(vld1q_u16(age + x), one), invalid);
+                        uint16x8_t vLast   = vbslq_u16(invalid, vld1q_u16(last + x), value);
+                        vst1q_u16(last + x, vLast);
+                        vst1q_u16(age + x, vAge);
+                        vst1q_u16(dst + x, vandq_u16(vLast, vcleq_u16(vAge, vRadius)));
+                    }
+#endif
+                    for(; x < x1; x++) {
+                        if(src[x] != 0) {
+                            last[x] = src[x];
+                            age[x]  = 0;
+                        }
+                        else if(age[x] != 0xffff) {
+                            age[x]++;
+                        }
+                        dst[x] = age[x] <= radius ? last[x] : 0;
+                    }
+                }
+            },
+            64);
+    }
+};
@@ -0,0 +1,833 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+#include "executor.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Calibration of the mapping of the depth camera into the color camera
+struct AlignCalibration {
+    OBCameraIntrinsic  depthIntrinsic;
+    OBCameraDistortion depthDistortion;
+    OBCameraIntrinsic  colorIntrinsic;
+    OBCameraDistortion colorDistortion;
+    OBExtrinsic        depthToColor;  // rotation (row major) and translation in millimeters
+};
+
+// Calibration of the current stream profiles, from Pipeline::getCameraParam()
+inline AlignCalibration alignCalibration(const OBCameraParam &param) {
+    AlignCalibration calibration;
+    calibration.depthIntrinsic  = param.depthIntrinsic;
+    calibration.depthDistortion = param.depthDistortion;
+    calibration.colorIntrinsic  = param.rgbIntrinsic;
+    calibration.colorDistortion = param.rgbDistortion;
+    calibration.depthToColor    = param.transform;
+    return calibration;
+}
+
+// Calibration of the sensors, from Pipeline::getCalibrationParam()
+inline AlignCalibration alignCalibration(const OBCalibrationParam &param) {
+    AlignCalibration calibration;
+    calibration.depthIntrinsic  = param.intrinsics[OB_SENSOR_DEPTH];
+    calibration.depthDistortion = param.distortion[OB_SENSOR_DEPTH];
+    calibration.colorIntrinsic  = param.intrinsics[OB_SENSOR_COLOR];
+    calibration.colorDistortion = param.distortion[OB_SENSOR_COLOR];
+    calibration.depthToColor    = param.extrinsics[OB_SENSOR_DEPTH][OB_SENSOR_COLOR];
+    return calibration;
+}
+
+// Pinhole camera with the intrinsics scaled to the resolution of the frames
+struct AlignCamera {
+    float              fx;
+    float              fy;
+    float              cx;
+    float              cy;
+    OBCameraDistortion distortion;
+    bool               distorted;
+
+    AlignCamera(const OBCameraIntrinsic &intrinsic, const OBCameraDistortion &dist, uint32_t width, uint32_t height) {
+        float sx   = intrinsic.width > 0 ? static_cast<float>(width) / intrinsic.width : 1.0f;
+        float sy   = intrinsic.height > 0 ? static_cast<float>(height) / intrinsic.height : 1.0f;
+        fx         = intrinsic.fx * sx;
+        fy         = intrinsic.fy * sy;
+        cx         = intrinsic.cx * sx;
+        cy         = intrinsic.cy * sy;
+        distortion = dist;
+        distorted  = dist.k1 != 0 || dist.k2 != 0 || dist.k3 != 0 || dist.k4 != 0 || dist.k5 != 0 || dist.k6 != 0 || dist.p1 != 0 || dist.p2 != 0;
+    }
+
+    // Apply the rational Brown-Conrady distortion to normalized coordinates
+    void distort(float &x, float &y) const {
+        const OBCameraDistortion &d      = distortion;
+        float                     r2     = x * x + y * y;
+        float                     radial = (1 + r2 * (d.k1 + r2 * (d.k2 + r2 * d.k3))) / (1 + r2 * (d.k4 + r2 * (d.k5 + r2 * d.k6)));
+        float                     xd     = x * radial + 2 * d.p1 * x * y + d.p2 * (r2 + 2 * x * x);
+        float                     yd     = y * radial + d.p1 * (r2 + 2 * y * y) + 2 * d.p2 * x * y;
+        x                                = xd;
+        y                                = yd;
+    }
+
+    // Inverse of distort(), by fixed point iteration
+    void undistort(float &x, float &y) const {
+        float xd = x;
+        float yd = y;
+        for(int i = 0; i < 10; i++) {
+            float px = x;
+            float py = y;
+            distort(px, py);
+            x += xd - px;
+            y += yd - py;
+        }
+    }
+};
+
+// Points of the depth image a table holds rays for
+enum AlignTableGrid {
+    ALIGN_GRID_CORNERS,  // corners of the pixels, (width + 1) x (height + 1) points, used to splat the depth (D2C)
+    ALIGN_GRID_CENTERS,  // centers of the pixels, width x height points, used to gather the color (C2D)
+};
+
+// Mapping tables of a calibration and a pair of resolutions.
+// For the point (i, j) of the grid, ray = R * undistorted((i, j)) so that this point of a depth pixel of depth z lands at
+// z * ray + T in the color camera. Everything but a multiply-add and the projection is precomputed.
+class AlignTable {
+public:
+    AlignTable(const AlignCalibration &calibration, uint32_t depthWidth, uint32_t depthHeight, uint32_t colorWidth, uint32_t colorHeight,
+               AlignTableGrid grid = ALIGN_GRID_CORNERS)
+        : grid_(grid),
+          depthWidth_(depthWidth),
+          depthHeight_(depthHeight),
+          colorWidth_(colorWidth),
+          colorHeight_(colorHeight),
+          depthCamera_(calibration.depthIntrinsic, calibration.depthDistortion, depthWidth, depthHeight),
+          colorCamera_(calibration.colorIntrinsic, calibration.colorDistortion, colorWidth, colorHeight) {
+        memcpy(rotation_, calibration.depthToColor.rot, sizeof(rotation_));
+        memcpy(translation_, calibration.depthToColor.trans, sizeof(translation_));
+
+        float  origin = grid == ALIGN_GRID_CORNERS ? -0.5f : 0.0f;
+        size_t points = static_cast<size_t>(gridWidth()) * gridHeight();
+        rayX_.resize(points);
+        rayY_.resize(points);
+        rayZ_.resize(points);
+        for(uint32_t j = 0; j < gridHeight(); j++) {
+            for(uint32_t i = 0; i < gridWidth(); i++) {
+                float x = (i + origin - depthCamera_.cx) / depthCamera_.fx;
+                float y = (j + origin - depthCamera_.cy) / depthCamera_.fy;
+                if(depthCamera_.distorted) {
+                    depthCamera_.undistort(x, y);
+                }
+                size_t index = static_cast<size_t>(j) * gridWidth() + i;
+                rayX_[index] = rotation_[0] * x + rotation_[1] * y + rotation_[2];
+                rayY_[index] = rotation_[3] * x + rotation_[4] * y + rotation_[5];
+                rayZ_[index] = rotation_[6] * x + rotation_[7] * y + rotation_[8];
+            }
+        }
+    }
+
+    AlignTableGrid grid() const {
+        return grid_;
+    }
+
+    // Points of the grid per row and per column
+    uint32_t gridWidth() const {
+        return grid_ == ALIGN_GRID_CORNERS ? depthWidth_ + 1 : depthWidth_;
+    }
+
+    uint32_t gridHeight() const {
+        return grid_ == ALIGN_GRID_CORNERS ? depthHeight_ + 1 : depthHeight_;
+    }
+
+    uint32_t depthWidth() const {
+        return depthWidth_;
+    }
+
+    uint32_t depthHeight() const {
+        return depthHeight_;
+    }
+
+    uint32_t colorWidth() const {
+        return colorWidth_;
+    }
+
+    uint32_t colorHeight() const {
+        return colorHeight_;
+    }
+
+    const AlignCamera &depthCamera() const {
+        return depthCamera_;
+    }
+
+    const AlignCamera &colorCamera() const {
+        return colorCamera_;
+    }
+
+    const float *rotation() const {
+        return rotation_;
+    }
+
+    const float *translation() const {
+        return translation_;
+    }
+
+    // Rays of the points of the grid, gridWidth() per row
+    const float *rayX() const {
+        return rayX_.data();
+    }
+
+    const float *rayY() const {
+        return rayY_.data();
+    }
+
+    const float *rayZ() const {
+        return rayZ_.data();
+    }
+
+    size_t memoryUsage() const {
+        return (rayX_.capacity() + rayY_.capacity() + rayZ_.capacity()) * sizeof(float);
+    }
+
+private:
+    AlignTableGrid     grid_;
+    uint32_t           depthWidth_;
+    uint32_t           depthHeight_;
+    uint32_t           colorWidth_;
+    uint32_t           colorHeight_;
+    AlignCamera        depthCamera_;
+    AlignCamera        colorCamera_;
+    float              rotation_[9];
+    float              translation_[3];
+    std::vector<float> rayX_;
+    std::vector<float> rayY_;
+    std::vector<float> rayZ_;
+};
+
+// Mapping tables shared by the aligners of the process, keyed by the calibration and the resolutions.
+// A table is built once per calibration, resolution pair and grid, then reused by every aligner and every frame.
+class AlignTableCache {
+public:
+    std::shared_ptr<const AlignTable> get(const AlignCalibration &calibration, uint32_t depthWidth, uint32_t depthHeight, uint32_t colorWidth,
+                                          uint32_t colorHeight, AlignTableGrid grid = ALIGN_GRID_CORNERS) {
+        std::vector<float> key(reinterpret_cast<const float *>(&calibration.depthToColor),
+                               reinterpret_cast<const float *>(&calibration.depthToColor) + sizeof(OBExtrinsic) / sizeof(float));
+        appendIntrinsic(key, calibration.depthIntrinsic);
+        appendIntrinsic(key, calibration.colorIntrinsic);
+        key.insert(key.end(), reinterpret_cast<const float *>(&calibration.depthDistortion),
+                   reinterpret_cast<const float *>(&calibration.depthDistortion) + sizeof(OBCameraDistortion) / sizeof(float));
+        key.insert(key.end(), reinterpret_cast<const float *>(&calibration.colorDistortion),
+                   reinterpret_cast<const float *>(&calibration.colorDistortion) + sizeof(OBCameraDistortion) / sizeof(float));
+        key.push_back(static_cast<float>(depthWidth));
+        key.push_back(static_cast<float>(depthHeight));
+        key.push_back(static_cast<float>(colorWidth));
+        key.push_back(static_cast<float>(colorHeight));
+        key.push_back(static_cast<float>(grid));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto                        iter = tables_.find(key);
+        if(iter != tables_.end()) {
+            return iter->second;
+        }
+        auto table   = std::make_shared<const AlignTable>(calibration, depthWidth, depthHeight, colorWidth, colorHeight, grid);
+        tables_[key] = table;
+        return table;
+    }
+
+    // Bytes used by the cached tables
+    size_t memoryUsage() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t                      bytes = 0;
+        for(auto &entry: tables_) {
+            bytes += entry.second->memoryUsage();
+        }
+        return bytes;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return tables_.size();
+    }
+
+    // Release the tables, the aligners keep the tables they use until their next resolution change
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tables_.clear();
+    }
+
+private:
+    mutable std::mutex                                                 mutex_;
+    std::map<std::vector<float>, std::shared_ptr<const AlignTable>> tables_;
+
+    static void appendIntrinsic(std::vector<float> &key, const OBCameraIntrinsic &intrinsic) {
+        key.push_back(intrinsic.fx);
+        key.push_back(intrinsic.fy);
+        key.push_back(intrinsic.cx);
+        key.push_back(intrinsic.cy);
+        key.push_back(intrinsic.width);
+        key.push_back(intrinsic.height);
+    }
+};
+
+inline AlignTableCache &alignTableCache() {
+    static AlignTableCache cache;
+    return cache;
+}
+
+// Software depth to color alignment (D2C) on the cached mapping tables.
+//
+// Each depth pixel is projected into the color image by its two opposite corners, and its depth in the color camera is
+// splatted over the color pixels between them, keeping the nearest depth where pixels overlap (z-buffer). The projection
+// runs over depth row bands with SSE2 on x86, the splatting over color row bands, so the result does not depend on the
+// number of threads. The output has the resolution of the color frames and the depth unit of the input.
+// An aligner processes one frame at a time.
+class DepthToColorAligner {
+public:
+    explicit DepthToColorAligner(const AlignCalibration &calibration, std::shared_ptr<Executor> executor = nullptr)
+        : calibration_(calibration), executor_(executor) {}
+
+    // Align the depth frame of a frame set to its color frame, returns a frame set with the color frame and the aligned depth
+    // frame. A depth frame alone is aligned to the resolution of the color intrinsics. Other frames are returned unchanged.
+    std::shared_ptr<ob::Frame> process(std::shared_ptr<ob::Frame> frame) {
+        if(frame == nullptr) {
+            return frame;
+        }
+        if(frame->type() == OB_FRAME_SET) {
+            auto frameSet   = frame->as<ob::FrameSet>();
+            auto depthFrame = frameSet->depthFrame();
+            auto colorFrame = frameSet->colorFrame();
+            if(depthFrame == nullptr || colorFrame == nullptr) {
+                return frame;
+            }
+            auto aligned = alignFrame(depthFrame, colorFrame->width(), colorFrame->height());
+            if(aligned == nullptr) {
+                return frame;
+            }
+            auto result = ob::FrameHelper::createFrameSet();
+            ob::FrameHelper::pushFrame(result, OB_FRAME_COLOR, colorFrame);
+            ob::FrameHelper::pushFrame(result, OB_FRAME_DEPTH, aligned);
+            return result;
+        }
+        if(frame->type() == OB_FRAME_DEPTH) {
+            auto aligned = alignFrame(frame->as<ob::DepthFrame>(), calibration_.colorIntrinsic.width, calibration_.colorIntrinsic.height);
+            return aligned ? aligned : frame;
+        }
+        return frame;
+    }
+
+    // Align a Y16 depth image, valueScale converts the depth values to millimeters. out has colorWidth * colorHeight pixels.
+    void align(const uint16_t *depth, uint32_t depthWidth, uint32_t depthHeight, float valueScale, uint16_t *out, uint32_t colorWidth, uint32_t colorHeight) {
+        if(!table_ || table_->depthWidth() != depthWidth || table_->depthHeight() != depthHeight || table_->colorWidth() != colorWidth
+           || table_->colorHeight() != colorHeight) {
+            table_ = alignTableCache().get(calibration_, depthWidth, depthHeight, colorWidth, colorHeight);
+        }
+        size_t pixels = static_cast<size_t>(depthWidth) * depthHeight;
+        if(z_.size() < pixels) {
+            u0_.resize(pixels);
+            v0_.resize(pixels);
+            u1_.resize(pixels);
+            v1_.resize(pixels);
+            z_.resize(pixels);
+        }
+        rowMinV_.resize(depthHeight);
+        rowMaxV_.resize(depthHeight);
+
+        forEachBand(
+            depthHeight,
+            [this, depth, valueScale](uint32_t y0, uint32_t y1) {
+                for(uint32_t y = y0; y < y1; y++) {
+                    projectRow(depth + static_cast<size_t>(y) * table_->depthWidth(), y, valueScale);
+                }
+            },
+            8);
+        forEachBand(
+            colorHeight,
+            [this, out](uint32_t y0, uint32_t y1) {
+                memset(out + static_cast<size_t>(y0) * table_->colorWidth(), 0, static_cast<size_t>(y1 - y0) * table_->colorWidth() * sizeof(uint16_t));
+                splat(out, y0, y1);
+            },
+            8);
+    }
+
+    std::shared_ptr<const AlignTable> table() const {
+        return table_;
+    }
+
+    // Bytes used by the per frame buffers of the aligner, the tables are reported by alignTableCache()
+    size_t memoryUsage() const {
+        return (u0_.capacity() + v0_.capacity() + u1_.capacity() + v1_.capacity()) * sizeof(int16_t) + z_.capacity() * sizeof(uint16_t)
+               + (rowMinV_.capacity() + rowMaxV_.capacity()) * sizeof(int32_t);
+    }
+
+private:
+    static const int16_t kInvalid = 0x7fff;  // u0 of the depth pixels without projection
+    static const int32_t kOffset  = 1024;    // coordinates are rounded as trunc(x + 0.5 + kOffset) - kOffset, lower x clamp to -kOffset
+
+    AlignCalibration                  calibration_;
+    std::shared_ptr<Executor>         executor_;
+    std::shared_ptr<const AlignTable> table_;
+    std::vector<int16_t>              u0_;  // projection of the top left corner of each depth pixel
+    std::vector<int16_t>              v0_;  //
+    std::vector<int16_t>              u1_;  // projection of the bottom right corner
+    std::vector<int16_t>              v1_;  //
+    std::vector<uint16_t>             z_;   // depth in the color camera
+    std::vector<int32_t>              rowMinV_;
+    std::vector<int32_t>              rowMaxV_;
+
+    std::shared_ptr<ob::Frame> alignFrame(std::shared_ptr<ob::DepthFrame> depthFrame, uint32_t colorWidth, uint32_t colorHeight) {
+        uint32_t width  = depthFrame->width();
+        uint32_t height = depthFrame->height();
+        if(depthFrame->format() != OB_FORMAT_Y16 || colorWidth == 0 || colorHeight == 0
+           || depthFrame->dataSize() < static_cast<uint64_t>(width) * height * sizeof(uint16_t)) {
+            return nullptr;
+        }
+        auto output = ob::FrameHelper::createFrame(OB_FRAME_DEPTH, OB_FORMAT_Y16, colorWidth, colorHeight, 0);
+        ob::FrameHelper::setFrameDeviceTimestampUs(output, depthFrame->timeStampUs());
+        ob::FrameHelper::setFrameSystemTimestamp(output, depthFrame->systemTimeStamp());
+        align(reinterpret_cast<const uint16_t *>(depthFrame->data()), width, height, depthFrame->getValueScale(),
+              reinterpret_cast<uint16_t *>(output->data()), colorWidth, colorHeight);
+        return output;
+    }
+
+    void forEachBand(uint32_t count, const std::function<void(uint32_t, uint32_t)> &body, uint32_t minCount) {
+        if(!executor_) {
+            body(0, count);
+            return;
+        }
+        parallelFor(*executor_, 0, count, minCount, [&body](size_t begin, size_t end) { body(static_cast<uint32_t>(begin), static_cast<uint32_t>(end)); });
+    }
+
+    static int32_t roundCoordinate(float value) {
+        return static_cast<int32_t>(std::min(65535.0f, std::max(0.0f, value + (0.5f + kOffset)))) - kOffset;
+    }
+
+    static int16_t saturate(int32_t value) {
+        return static_cast<int16_t>(std::min<int32_t>(32767, std::max<int32_t>(-32768, value)));
+    }
+
+    // Project the corners of the pixels of depth row y
+    void projectRow(const uint16_t *depth, uint32_t y, float valueScale) {
+        const uint32_t     width    = table_->depthWidth();
+        const AlignCamera &color    = table_->colorCamera();
+        const float       *t        = table_->translation();
+        const float       *rayX0    = table_->rayX() + static_cast<size_t>(y) * (width + 1);
+        const float       *rayY0    = table_->rayY() + static_cast<size_t>(y) * (width + 1);
+        const float       *rayZ0    = table_->rayZ() + static_cast<size_t>(y) * (width + 1);
+        const float       *rayX1    = rayX0 + width + 2;
+        const float       *rayY1    = rayY0 + width + 2;
+        const float       *rayZ1    = rayZ0 + width + 2;
+        const float        invScale = 1.0f / valueScale;
+        const size_t       offset   = static_cast<size_t>(y) * width;
+        int16_t           *u0       = &u0_[offset];
+        int16_t           *v0       = &v0_[offset];
+        int16_t           *u1       = &u1_[offset];
+        int16_t           *v1       = &v1_[offset];
+        uint16_t          *z        = &z_[offset];
+        uint32_t           x        = 0;
+#if defined(OB_EXAMPLES_SSE2)
+        if(!color.distorted) {
+            const __m128i zero      = _mm_setzero_si128();
+            const __m128  zeroF     = _mm_setzero_ps();
+            const __m128  one       = _mm_set1_ps(1.0f);
+            const __m128  scale     = _mm_set1_ps(valueScale);
+            const __m128  halfScale = _mm_set1_ps(0.5f * invScale);
+            const __m128  tx        = _mm_set1_ps(t[0]);
+            const __m128  ty        = _mm_set1_ps(t[1]);
+            const __m128  tz        = _mm_set1_ps(t[2]);
+            const __m128  fx        = _mm_set1_ps(color.fx);
+            const __m128  fy        = _mm_set1_ps(color.fy);
+            const __m128  cx        = _mm_set1_ps(color.cx);
+            const __m128  cy        = _mm_set1_ps(color.cy);
+            const __m128  round     = _mm_set1_ps(0.5f + kOffset);
+            const __m128  max       = _mm_set1_ps(65535.0f);
+            const __m128i offset32  = _mm_set1_epi32(kOffset);
+            const __m128i bias32    = _mm_set1_epi32(32768);
+            const __m128i bias16    = _mm_set1_epi16(static_cast<short>(0x8000));
+            const __m128i invalid   = _mm_set1_epi16(kInvalid);
+            for(; x + 4 <= width; x += 4) {
+                __m128 depthZ = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(depth + x)), zero)), scale);
+                __m128 px0    = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(rayX0 + x), depthZ), tx);
+                __m128 py0    = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(rayY0 + x), depthZ), ty);
+                __m128 pz0    = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(rayZ0 + x), depthZ), tz);
+                __m128 px1    = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(rayX1 + x), depthZ), tx);
+                __m128 py1    = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(rayY1 + x), depthZ), ty);
+                __m128 pz1    = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(rayZ1 + x), depthZ), tz);
+                __m128 valid  = _mm_and_ps(_mm_cmpgt_ps(depthZ, zeroF), _mm_and_ps(_mm_cmpgt_ps(pz0, zeroF), _mm_cmpgt_ps(pz1, zeroF)));
+                __m128 iz0    = _mm_div_ps(one, pz0);
+                __m128 iz1    = _mm_div_ps(one, pz1);
+
+                __m128i iu0 = toInt(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(px0, iz0), fx), cx), round, max, offset32);
+                __m128i iv0 = toInt(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(py0, iz0), fy), cy), round, max, offset32);
+                __m128i iu1 = toInt(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(px1, iz1), fx), cx), round, max, offset32);
+                __m128i iv1 = toInt(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(py1, iz1), fy), cy), round, max, offset32);
+                __m128i iz  = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(pz0, pz1), halfScale), _mm_set1_ps(0.5f)), zeroF), max));
+
+                __m128i mask  = _mm_castps_si128(valid);
+                mask          = _mm_packs_epi32(mask, mask);
+                __m128i uv0   = _mm_or_si128(_mm_and_si128(_mm_packs_epi32(iu0, iv0), mask), _mm_andnot_si128(mask, invalid));
+                __m128i uv1   = _mm_packs_epi32(iu1, iv1);
+                __m128i outZ  = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(iz, bias32), zero), bias16);
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(u0 + x), uv0);
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(v0 + x), _mm_srli_si128(uv0, 8));
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(u1 + x), uv1);
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(v1 + x), _mm_srli_si128(uv1, 8));
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(z + x), outZ);
+            }
+        }
+#endif
+        // Same arithmetic as the vector kernel, with the color distortion when the color camera has one
+        for(; x < width; x++) {
+            float depthZ = depth[x] * valueScale;
+            float px0    = rayX0[x] * depthZ + t[0];
+            float py0    = rayY0[x] * depthZ + t[1];
+            float pz0    = rayZ0[x] * depthZ + t[2];
+            float px1    = rayX1[x] * depthZ + t[0];
+            float py1    = rayY1[x] * depthZ + t[1];
+            float pz1    = rayZ1[x] * depthZ + t[2];
+            if(!(depthZ > 0 && pz0 > 0 && pz1 > 0)) {
+                u0[x] = kInvalid;
+                v0[x] = kInvalid;
+                continue;
+            }
+            float iz0 = 1.0f / pz0;
+            float iz1 = 1.0f / pz1;
+            float xn0 = px0 * iz0;
+            float yn0 = py0 * iz0;
+            float xn1 = px1 * iz1;
+            float yn1 = py1 * iz1;
+            if(color.distorted) {
+                color.distort(xn0, yn0);
+                color.distort(xn1, yn1);
+            }
+            u0[x] = saturate(roundCoordinate(xn0 * color.fx + color.cx));
+            v0[x] = saturate(roundCoordinate(yn0 * color.fy + color.cy));
+            u1[x] = saturate(roundCoordinate(xn1 * color.fx + color.cx));
+            v1[x] = saturate(roundCoordinate(yn1 * color.fy + color.cy));
+            z[x]  = static_cast<uint16_t>(std::min(65535.0f, std::max(0.0f, (pz0 + pz1) * (0.5f * invScale) + 0.5f)));
+        }
+
+        int32_t minV = 32767;
+        int32_t maxV = -32768;
+        for(x = 0; x < width; x++) {
+            if(u0[x] != kInvalid) {
+                minV = std::min<int32_t>(minV, std::min(v0[x], v1[x]));
+                maxV = std::max<int32_t>(maxV, std::max(v0[x], v1[x]));
+            }
+        }
+        rowMinV_[y] = minV;
+        rowMaxV_[y] = maxV;
+    }
+
+#if defined(OB_EXAMPLES_SSE2)
+    static __m128i toInt(__m128 value, __m128 round, __m128 max, __m128i offset) {
+        return _mm_sub_epi32(_mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(value, round), _mm_setzero_ps()), max)), offset);
+    }
+#endif
+
+    // Write the depth of the projected pixels covering the color rows [rowBegin, rowEnd), the nearest depth wins
+    void splat(uint16_t *out, uint32_t rowBegin, uint32_t rowEnd) const {
+        const uint32_t depthWidth = table_->depthWidth();
+        const int32_t  colorWidth = static_cast<int32_t>(table_->colorWidth());
+        for(uint32_t y = 0; y < table_->depthHeight(); y++) {
+            if(rowMaxV_[y] < static_cast<int32_t>(rowBegin) || rowMinV_[y] >= static_cast<int32_t>(rowEnd)) {
+                continue;
+            }
+            const size_t offset = static_cast<size_t>(y) * depthWidth;
+            for(uint32_t x = 0; x < depthWidth; x++) {
+                size_t i = offset + x;
+                if(u0_[i] == kInvalid) {
+                    continue;
+                }
+                int32_t uBegin = std::min(u0_[i], u1_[i]);
+                int32_t uEnd   = std::max<int32_t>(std::max(u0_[i], u1_[i]), uBegin + 1);
+                int32_t vBegin = std::min(v0_[i], v1_[i]);
+                int32_t vEnd   = std::max<int32_t>(std::max(v0_[i], v1_[i]), vBegin + 1);
+                uBegin         = std::max(uBegin, 0);
+                uEnd           = std::min(uEnd, colorWidth);
+                vBegin         = std::max(vBegin, static_cast<int32_t>(rowBegin));
+                vEnd           = std::min(vEnd, static_cast<int32_t>(rowEnd));
+                uint16_t depth = z_[i];
+                for(int32_t v = vBegin; v < vEnd; v++) {
+                    uint16_t *row = out + static_cast<size_t>(v) * colorWidth;
+                    for(int32_t u = uBegin; u < uEnd; u++) {
+                        if(row[u] == 0 || depth < row[u]) {
+                            row[u] = depth;
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
+
+// Sampling of the color image by a ColorToDepthAligner
+enum AlignInterpolation {
+    ALIGN_INTERPOLATION_NEAREST,   // the color pixel the depth pixel lands on
+    ALIGN_INTERPOLATION_BILINEAR,  // the 4 color pixels around it, weighted
+};
+
+// Software color to depth alignment (C2D).
+//
+// The center of each depth pixel is projected into the color image with its depth and the color is read there. The output
+// has the resolution of the depth frames: only the sampled color pixels are read, there is no copy or resize of the full
+// color image, so the cost follows the depth resolution whatever the color resolution. Depth pixels without depth or
+// projected outside of the color image are black. The projection is vectorized with SSE2 on x86 and runs over depth row
+// bands on the executor.
+// The color must be RGB, BGR, RGBA, BGRA or Y8, decode the other formats with a FormatConvertFilter first.
+class ColorToDepthAligner {
+public:
+    explicit ColorToDepthAligner(const AlignCalibration &calibration, AlignInterpolation interpolation = ALIGN_INTERPOLATION_BILINEAR,
+                                 std::shared_ptr<Executor> executor = nullptr)
+        : calibration_(calibration), interpolation_(interpolation), executor_(executor) {}
+
+    // Bytes per pixel of the supported color formats, 0 for the others
+    static uint32_t bytesPerPixel(OBFormat format) {
+        switch(format) {
+        case OB_FORMAT_RGB:
+        case OB_FORMAT_BGR:
+            return 3;
+        case OB_FORMAT_RGBA:
+        case OB_FORMAT_BGRA:
+            return 4;
+        case OB_FORMAT_Y8:
+            return 1;
+        default:
+            return 0;
+        }
+    }
+
+    // Align the color frame of a frame set to its depth frame, returns a frame set with the aligned color frame and the depth
+    // frame. Frame sets without depth or with an unsupported color format are returned unchanged.
+    std::shared_ptr<ob::Frame> process(std::shared_ptr<ob::Frame> frame) {
+        if(frame == nullptr || frame->type() != OB_FRAME_SET) {
+            return frame;
+        }
+        auto frameSet   = frame->as<ob::FrameSet>();
+        auto depthFrame = frameSet->depthFrame();
+        auto colorFrame = frameSet->colorFrame();
+        if(depthFrame == nullptr || colorFrame == nullptr || depthFrame->format() != OB_FORMAT_Y16) {
+            return frame;
+        }
+        uint32_t bpp         = bytesPerPixel(colorFrame->format());
+        uint32_t depthWidth  = depthFrame->width();
+        uint32_t depthHeight = depthFrame->height();
+        uint32_t colorWidth  = colorFrame->width();
+        uint32_t colorHeight = colorFrame->height();
+        if(bpp == 0 || colorFrame->dataSize() < static_cast<uint64_t>(colorWidth) * colorHeight * bpp
+           || depthFrame->dataSize() < static_cast<uint64_t>(depthWidth) * depthHeight * sizeof(uint16_t)) {
+            return frame;
+        }
+
+        auto output = ob::FrameHelper::createFrame(OB_FRAME_COLOR, colorFrame->format(), depthWidth, depthHeight, 0);
+        ob::FrameHelper::setFrameDeviceTimestampUs(output, colorFrame->timeStampUs());
+        ob::FrameHelper::setFrameSystemTimestamp(output, colorFrame->systemTimeStamp());
+        align(reinterpret_cast<const uint16_t *>(depthFrame->data()), depthWidth, depthHeight, depthFrame->getValueScale(),
+              reinterpret_cast<const uint8_t *>(colorFrame->data()), colorWidth, colorHeight, bpp, reinterpret_cast<uint8_t *>(output->data()));
+
+        auto result = ob::FrameHelper::createFrameSet();
+        ob::FrameHelper::pushFrame(result, OB_FRAME_COLOR, output);
+        ob::FrameHelper::pushFrame(result, OB_FRAME_DEPTH, depthFrame);
+        return result;
+    }
+
+    // Gather the color of each depth pixel, valueScale converts the depth values to millimeters. out has depthWidth *
+    // depthHeight pixels of bytesPerPixel bytes.
+    void align(const uint16_t *depth, uint32_t depthWidth, uint32_t depthHeight, float valueScale, const uint8_t *color, uint32_t colorWidth,
+               uint32_t colorHeight, uint32_t bytesPerPixel, uint8_t *out) {
+        if(!table_ || table_->depthWidth() != depthWidth || table_->depthHeight() != depthHeight || table_->colorWidth() != colorWidth
+           || table_->colorHeight() != colorHeight) {
+            table_ = alignTableCache().get(calibration_, depthWidth, depthHeight, colorWidth, colorHeight, ALIGN_GRID_CENTERS);
+        }
+
+        auto body = [this, depth, valueScale, color, bytesPerPixel, out](uint32_t y0, uint32_t y1) {
+            std::vector<float> u(table_->depthWidth());
+            std::vector<float> v(table_->depthWidth());
+            for(uint32_t y = y0; y < y1; y++) {
+                size_t offset = static_cast<size_t>(y) * table_->depthWidth();
+                projectRow(depth + offset, y, valueScale, u.data(), v.data());
+                switch(bytesPerPixel) {
+                case 1:
+                    gatherRow<1>(u.data(), v.data(), color, out + offset);
+                    break;
+                case 3:
+                    gatherRow<3>(u.data(), v.data(), color, out + offset * 3);
+                    break;
+                default:
+                    gatherRow<4>(u.data(), v.data(), color, out + offset * 4);
+                    break;
+                }
+            }
+        };
+        if(!executor_) {
+            body(0, depthHeight);
+            return;
+        }
+        parallelFor(*executor_, 0, depthHeight, 8, [&body](size_t begin, size_t end) { body(static_cast<uint32_t>(begin), static_cast<uint32_t>(end)); });
+    }
+
+    std::shared_ptr<const AlignTable> table() const {
+        return table_;
+    }
+
+private:
+    AlignCalibration                  calibration_;
+    AlignInterpolation                interpolation_;
+    std::shared_ptr<Executor>         executor_;
+    std::shared_ptr<const AlignTable> table_;
+
+    // Color coordinates of the centers of the pixels of depth row y, -1 for the pixels without projection
+    void projectRow(const uint16_t *depth, uint32_t y, float valueScale, float *u, float *v) const {
+        const uint32_t     width = table_->depthWidth();
+        const AlignCamera &cam   = table_->colorCamera();
+        const float       *t     = table_->translation();
+        const float       *rayX  = table_->rayX() + static_cast<size_t>(y) * width;
+        const float       *rayY  = table_->rayY() + static_cast<size_t>(y) * width;
+        const float       *rayZ  = table_->rayZ() + static_cast<size_t>(y) * width;
+        uint32_t           x     = 0;
+#if defined(OB_EXAMPLES_SSE2)
+        if(!cam.distorted) {
+            const __m128i zero  = _mm_setzero_si128();
+            const __m128  zeroF = _mm_setzero_ps();
+            const __m128  one   = _mm_set1_ps(1.0f);
+            const __m128  minus = _mm_set1_ps(-1.0f);
+            const __m128  scale = _mm_set1_ps(valueScale);
+            const __m128  tx    = _mm_set1_ps(t[0]);
+            const __m128  ty    = _mm_set1_ps(t[1]);
+            const __m128  tz    = _mm_set1_ps(t[2]);
+            const __m128  fx    = _mm_set1_ps(cam.fx);
+            const __m128  fy    = _mm_set1_ps(cam.fy);
+            const __m128  cx    = _mm_set1_ps(cam.cx);
+            const __m128  cy    = _mm_set1_ps(cam.cy);
+            for(; x + 4 <= width; x += 4) {
+                __m128 depthZ = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(depth + x)), zero)), scale);
+                __m128 px     = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(rayX + x), depthZ), tx);
+                __m128 py     = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(rayY + x), depthZ), ty);
+                __m128 pz     = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(rayZ + x), depthZ), tz);
+                __m128 valid  = _mm_and_ps(_mm_cmpgt_ps(depthZ, zeroF), _mm_cmpgt_ps(pz, zeroF));
+                __m128 iz     = _mm_div_ps(one, pz);
+                __m128 cu     = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(px, iz), fx), cx);
+                __m128 cv     = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(py, iz), fy), cy);
+                _mm_storeu_ps(u + x, _mm_or_ps(_mm_and_ps(valid, cu), _mm_andnot_ps(valid, minus)));
+                _mm_storeu_ps(v + x, _mm_or_ps(_mm_and_ps(valid, cv), _mm_andnot_ps(valid, minus)));
+            }
+        }
+#endif
+        for(; x < width; x++) {
+            float depthZ = depth[x] * valueScale;
+            float px     = rayX[x] * depthZ + t[0];
+            float py     = rayY[x] * depthZ + t[1];
+            float pz     = rayZ[x] * depthZ + t[2];
+            if(!(depthZ > 0 && pz > 0)) {
+                u[x] = -1.0f;
+                v[x] = -1.0f;
+                continue;
+            }
+            float iz = 1.0f / pz;
+            float xn = px * iz;
+            float yn = py * iz;
+            if(cam.distorted) {
+                cam.distort(xn, yn);
+            }
+            u[x] = xn * cam.fx + cam.cx;
+            v[x] = yn * cam.fy + cam.cy;
+        }
+    }
+
+    template <uint32_t Bpp> void gatherRow(const float *u, const float *v, const uint8_t *color, uint8_t *out) const {
+        const uint32_t width       = table_->depthWidth();
+        const uint32_t colorWidth  = table_->colorWidth();
+        const uint32_t colorHeight = table_->colorHeight();
+        const size_t   stride      = static_cast<size_t>(colorWidth) * Bpp;
+        if(interpolation_ == ALIGN_INTERPOLATION_NEAREST) {
+            for(uint32_t x = 0; x < width; x++, out += Bpp) {
+                // u > -0.5 first, so the truncation below rounds to nearest
+                uint32_t cu = u[x] > -0.5f ? static_cast<uint32_t>(u[x] + 0.5f) : colorWidth;
+                uint32_t cv = v[x] > -0.5f ? static_cast<uint32_t>(v[x] + 0.5f) : colorHeight;
+                if(cu >= colorWidth || cv >= colorHeight) {
+                    memset(out, 0, Bpp);
+                    continue;
+                }
+                memcpy(out, color + cv * stride + cu * Bpp, Bpp);
+            }
+            return;
+        }
+
+        // Bilinear weights in 8 bit fixed point
+        const float maxU = static_cast<float>(colorWidth - 1);
+        const float maxV = static_cast<float>(colorHeight - 1);
+        for(uint32_t x = 0; x < width; x++, out += Bpp) {
+            if(!(u[x] >= 0 && v[x] >= 0 && u[x] <= maxU && v[x] <= maxV)) {
+                memset(out, 0, Bpp);
+                continue;
+            }
+            uint32_t       u0  = static_cast<uint32_t>(u[x]);
+            uint32_t       v0  = static_cast<uint32_t>(v[x]);
+            uint32_t       wu  = static_cast<uint32_t>((u[x] - u0) * 256.0f);
+            uint32_t       wv  = static_cast<uint32_t>((v[x] - v0) * 256.0f);
+            const uint8_t *p00 = color + v0 * stride + u0 * Bpp;
+            const uint8_t *p01 = u0 + 1 < colorWidth ? p00 + Bpp : p00;
+            const uint8_t *p10 = v0 + 1 < colorHeight ? p00 + stride : p00;
+            const uint8_t *p11 = p10 + (p01 - p00);
+            for(uint32_t c = 0; c < Bpp; c++) {
+                uint32_t top    = p00[c] * (256 - wu) + p01[c] * wu;
+                uint32_t bottom = p10[c] * (256 - wu) + p11[c] * wu;
+                out[c]          = static_cast<uint8_t>((top * (256 - wv) + bottom * wv + 32768) >> 16);
+            }
+        }
+    }
+};
+
+// Depth to color camera transformation with persistent state, for per frame use in place of
+// CoordinateTransformHelper::transformationDepthFrameToColorCamera(), which reads the calibration from the device and
+// allocates a frame on every call.
+// A transformer is built once for a calibration and a target size. It keeps the mapping tables, the buffers of the
+// projection and an output buffer across frames, and runs the DepthToColorAligner kernels on the executor.
+class DepthToColorTransformer {
+public:
+    DepthToColorTransformer(const OBCalibrationParam &param, uint32_t colorWidth, uint32_t colorHeight, std::shared_ptr<Executor> executor = nullptr)
+        : aligner_(alignCalibration(param), executor), width_(colorWidth), height_(colorHeight), output_(static_cast<size_t>(colorWidth) * colorHeight) {}
+
+    uint32_t width() const {
+        return width_;
+    }
+
+    uint32_t height() const {
+        return height_;
+    }
+
+    // Transform a Y16 depth frame into out, width() * height() depth values in the unit of the input frame (scale them by its
+    // value scale). Returns false for the frames that are not Y16 depth.
+    bool transform(std::shared_ptr<ob::DepthFrame> depthFrame, uint16_t *out) {
+        if(depthFrame == nullptr || depthFrame->format() != OB_FORMAT_Y16 || width_ == 0 || height_ == 0) {
+            return false;
+        }
+        uint32_t depthWidth  = depthFrame->width();
+        uint32_t depthHeight = depthFrame->height();
+        if(depthFrame->dataSize() < static_cast<uint64_t>(depthWidth) * depthHeight * sizeof(uint16_t)) {
+            return false;
+        }
+        aligner_.align(reinterpret_cast<const uint16_t *>(depthFrame->data()), depthWidth, depthHeight, depthFrame->getValueScale(), out, width_, height_);
+        return true;
+    }
+
+    // Transform into the buffer of the transformer, valid until the next call. Returns nullptr when the frame is not Y16 depth.
+    const uint16_t *transform(std::shared_ptr<ob::DepthFrame> depthFrame) {
+        return transform(depthFrame, output_.data()) ? output_.data() : nullptr;
+    }
+
+    // Bytes used by the buffers of the transformer, the tables are reported by alignTableCache()
+    size_t memoryUsage() const {
+        return aligner_.memoryUsage() + output_.capacity() * sizeof(uint16_t);
+    }
+
+private:
+    DepthToColorAligner   aligner_;
+    uint32_t              width_;
+    uint32_t              height_;
+    std::vector<uint16_t> output_;
+};
@@ -0,0 +1,280 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One IMU sample, packed to 32 bytes
+struct ImuSample {
+    uint64_t    timestampUs;  // device timestamp
+    float       x;            // m/s^2 for OB_FRAME_ACCEL, rad/s for OB_FRAME_GYRO
+    float       y;            //
+    float       z;            //
+    float       temperature;  // Celsius
+    OBFrameType type;         // OB_FRAME_ACCEL or OB_FRAME_GYRO
+    uint32_t    index;        // frame index, low 32 bits
+};
+
+// Single producer single consumer ring of fixed capacity (rounded up to a power of 2). push() and pop() never block and
+// never allocate, one thread pushes and one thread pops.
+template <typename T> class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) : head_(0), tail_(0) {
+        size_t size = 2;
+        while(size < capacity) {
+            size <<= 1;
+        }
+        items_.resize(size);
+        mask_ = size - 1;
+    }
+
+    // false when the ring is full
+    bool push(const T &item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if(tail - head_.load(std::memory_order_acquire) > mask_) {
+            return false;
+        }
+        items_[tail & mask_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Move up to maxCount items to out, returns the number of items moved
+    size_t pop(T *out, size_t maxCount) {
+        size_t head  = head_.load(std::memory_order_relaxed);
+        size_t count = std::min(tail_.load(std::memory_order_acquire) - head, maxCount);
+        for(size_t i = 0; i < count; i++) {
+            out[i] = items_[(head + i) & mask_];
+        }
+        head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const {
+        return mask_ + 1;
+    }
+
+private:
+    std::vector<T> items_;
+    size_t         mask_;
+    // The producer and the consumer write different cache lines
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+};
+
+// Batched delivery of the accelerometer and gyroscope samples.
+//
+// The sensor callbacks of accelCallback() and gyroCallback() copy each sample into a ring per sensor and return, so the
+// SDK callback threads do no other work. The application takes the samples in bulk, either with drain() from its own thread
+// or from a batch callback run on a thread of the reader every batchSize samples or every maxDelay, whichever comes first.
+// Samples of both sensors come out in timestamp order, across batches too: a sample newer than the last sample received from
+// the other sensor is held back until the other sensor catches up, or until it has sent nothing for the hold back time
+// (setHoldBack(), 50ms by default), e.g. when only one of them is started. A sample of the other sensor arriving later than
+// that is still delivered, out of order. When the application falls behind the rings fill up and the new samples are
+// dropped and counted.
+// Use drain() or a batch callback, not both.
+class ImuBatchReader {
+public:
+    typedef std::function<void(const ImuSample *samples, size_t count)> BatchCallback;
+
+    explicit ImuBatchReader(size_t capacity = 8192)
+        : accel_(capacity), gyro_(capacity), received_(0), dropped_(0), batches_(0), batchSize_(0), wakeRequested_(false), stop_(false),
+          wakeup_(false), holdBack_(std::chrono::milliseconds(50)), accelLatestUs_(0), gyroLatestUs_(0) {}
+
+    ~ImuBatchReader() {
+        stopBatches();
+    }
+
+    // Callbacks for Sensor::start(profile, callback) of the accelerometer and the gyroscope
+    ob::FrameCallback accelCallback() {
+        return [this](std::shared_ptr<ob::Frame> frame) { push(accel_, frame); };
+    }
+
+    ob::FrameCallback gyroCallback() {
+        return [this](std::shared_ptr<ob::Frame> frame) { push(gyro_, frame); };
+    }
+
+    // Time a sample waits for the samples of the other sensor that may precede it, set before draining
+    void setHoldBack(std::chrono::milliseconds holdBack) {
+        holdBack_ = holdBack;
+    }
+
+    // Append the samples ready to samples in timestamp order, returns the number of samples appended
+    size_t drain(std::vector<ImuSample> &samples) {
+        auto now   = std::chrono::steady_clock::now();
+        bool accel = take(accel_, accelPending_, accelLatestUs_);
+        bool gyro  = take(gyro_, gyroPending_, gyroLatestUs_);
+        if(accel) {
+            accelArrival_ = now;
+        }
+        if(gyro) {
+            gyroArrival_ = now;
+        }
+
+        // The samples of a sensor are in timestamp order, so the ones not newer than the last sample of the other sensor
+        // can not be preceded by a sample still to come
+        bool   accelIdle  = now - accelArrival_ > holdBack_;
+        bool   gyroIdle   = now - gyroArrival_ > holdBack_;
+        size_t accelCount = readyCount(accelPending_, gyroIdle, gyroLatestUs_);
+        size_t gyroCount  = readyCount(gyroPending_, accelIdle, accelLatestUs_);
+
+        size_t first = samples.size();
+        samples.resize(first + accelCount + gyroCount);
+        std::merge(accelPending_.begin(), accelPending_.begin() + accelCount, gyroPending_.begin(), gyroPending_.begin() + gyroCount, samples.begin() + first,
+                   [](const ImuSample &a, const ImuSample &b) { return a.timestampUs < b.timestampUs; });
+        accelPending_.erase(accelPending_.begin(), accelPending_.begin() + accelCount);
+        gyroPending_.erase(gyroPending_.begin(), gyroPending_.begin() + gyroCount);
+        return accelCount + gyroCount;
+    }
+
+    // Deliver the samples to callback from a thread of the reader, in batches of at least batchSize samples or after maxDelay
+    void startBatches(BatchCallback callback, size_t batchSize, std::chrono::milliseconds maxDelay) {
+        stopBatches();
+        batchSize_ = std::max<size_t>(batchSize, 1);
+        stop_      = false;
+        thread_    = std::thread([this, callback, maxDelay]() {
+            std::vector<ImuSample> batch;
+            while(true) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait_for(lock, maxDelay, [this]() { return stop_ || wakeup_; });
+                    wakeup_ = false;
+                    if(stop_) {
+                        break;
+                    }
+                }
+                wakeRequested_ = false;
+                batch.clear();
+                if(drain(batch) > 0) {
+                    callback(batch.data(), batch.size());
+                    batches_++;
+                }
+            }
+        });
+    }
+
+    void stopBatches() {
+        if(!thread_.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+        batchSize_ = 0;
+    }
+
+    uint64_t receivedCount() const {
+        return received_;
+    }
+
+    uint64_t droppedCount() const {
+        return dropped_;
+    }
+
+    uint64_t batchCount() const {
+        return batches_;
+    }
+
+private:
+    SpscRing<ImuSample>     accel_;
+    SpscRing<ImuSample>     gyro_;
+    std::vector<ImuSample>  accelPending_;  // samples taken from the rings and not delivered yet
+    std::vector<ImuSample>  gyroPending_;   //
+    std::atomic<uint64_t>   received_;
+    std::atomic<uint64_t>   dropped_;
+    std::atomic<uint64_t>   batches_;
+    std::atomic<size_t>     batchSize_;
+    std::atomic<bool>       wakeRequested_;
+    std::mutex              mutex_;
+    std::condition_variable cv_;
+    bool                    stop_;
+    bool                    wakeup_;
+    std::thread             thread_;
+
+    // Hold back state, used by the draining thread only
+    std::chrono::steady_clock::duration   holdBack_;
+    std::chrono::steady_clock::time_point accelArrival_;  // last drain that took accelerometer samples
+    std::chrono::steady_clock::time_point gyroArrival_;   //
+    uint64_t                              accelLatestUs_;  // timestamp of the last sample taken
+    uint64_t                              gyroLatestUs_;   //
+
+    // Move the samples of ring to the end of pending, false when there are none
+    static bool take(SpscRing<ImuSample> &ring, std::vector<ImuSample> &pending, uint64_t &latestUs) {
+        size_t first = pending.size();
+        pending.resize(first + ring.size());
+        size_t count = ring.pop(pending.data() + first, pending.size() - first);
+        pending.resize(first + count);
+        if(count == 0) {
+            return false;
+        }
+        latestUs = pending.back().timestampUs;
+        return true;
+    }
+
+    // Number of pending samples that can be delivered: all of them when the other sensor is idle, else the ones not newer
+    // than its last sample
+    static size_t readyCount(const std::vector<ImuSample> &pending, bool otherIdle, uint64_t otherLatestUs) {
+        if(otherIdle) {
+            return pending.size();
+        }
+        auto last = std::upper_bound(pending.begin(), pending.end(), otherLatestUs,
+                                     [](uint64_t timestampUs, const ImuSample &sample) { return timestampUs < sample.timestampUs; });
+        return static_cast<size_t>(last - pending.begin());
+    }
+
+    void push(SpscRing<ImuSample> &ring, std::shared_ptr<ob::Frame> frame) {
+        ImuSample    sample;
+        OBAccelValue value;
+        sample.timestampUs = frame->timeStampUs();
+        sample.type        = frame->type();
+        sample.index       = static_cast<uint32_t>(frame->index());
+        if(sample.type == OB_FRAME_ACCEL) {
+            auto accelFrame    = frame->as<ob::AccelFrame>();
+            value              = accelFrame->value();
+            sample.temperature = accelFrame->temperature();
+        }
+        else if(sample.type == OB_FRAME_GYRO) {
+            auto gyroFrame     = frame->as<ob::GyroFrame>();
+            value              = gyroFrame->value();
+            sample.temperature = gyroFrame->temperature();
+        }
+        else {
+            return;
+        }
+        sample.x = value.x;
+        sample.y = value.y;
+        sample.z = value.z;
+
+        received_++;
+        if(!ring.push(sample)) {
+            dropped_++;
+            return;
+        }
+        // Wake the batch thread once per batch, the lock is only taken then
+        size_t batchSize = batchSize_;
+        if(batchSize > 0 && accel_.size() + gyro_.size() >= batchSize && !wakeRequested_.exchange(true)) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                wakeup_ = true;
+            }
+            cv_.notify_one();
+        }
+    }
+};
@@ -0,0 +1,227 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "depth_filter.hpp"
+#include "disparity_transform.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+// Host side noise removal filter: invalidates the speckles, the small patches of depth that are not connected to the
+// surfaces around them.
+//
+// Two 4-neighbors are connected when both are valid and their disparities differ by at most disp_diff, as in the SDK filter.
+// The disparities are looked up in the fixed point table of setDisparityTable(), so disp_diff is in 1/2^fractionBits pixel
+// of that table; without table the depth values are compared and disp_diff is a depth difference in the depth unit, which
+// keeps objects far away more connected than the SDK filter does. The connected components of at most max_size pixels are
+// set to 0. Labelling is union-find over runs: each row is split in runs of connected
+// pixels, runs of consecutive rows are merged where they touch. Row bands are labelled in parallel, then the seams between
+// the bands are merged, so the result does not depend on the number of bands.
+// With a region of interest, the components are measured within the region extended by maxSize pixels, which gives the
+// same result in the region as on the whole frame.
+class HostNoiseRemovalFilter : public DepthFilter {
+public:
+    explicit HostNoiseRemovalFilter(std::shared_ptr<Executor> executor = nullptr) : DepthFilter(executor), disparity_(nullptr) {
+        params_.max_size  = 80;
+        params_.disp_diff = 256;
+        params_.type      = OB_NR_OVERALL;
+    }
+
+    const char *type() const override {
+        return "HostNoiseRemovalFilter";
+    }
+
+    // max_size and disp_diff are used, type is ignored
+    void setFilterParams(OBNoiseRemovalFilterParams params) {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        params_ = params;
+    }
+
+    OBNoiseRemovalFilterParams getFilterParams() {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        return params_;
+    }
+
+    // Depth to fixed point disparity table of the depth unit of the frames (HostDisparityTransform::table()), nullptr to
+    // compare the depths. A float precision table is ignored.
+    void setDisparityTable(std::shared_ptr<const DisparityTable> table) {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        table_ = table && table->fixed() ? table : nullptr;
+    }
+
+protected:
+    void loadParams() override {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        frameParams_ = params_;
+        frameTable_  = table_;
+        disparity_   = table_ ? table_->fixed() : nullptr;
+    }
+
+    uint32_t haloSize() const override {
+        return frameParams_.max_size;
+    }
+
+    void processImage(const DepthImage &image) override {
+        const uint32_t width  = image.width;
+        const uint32_t height = image.height;
+        const size_t   pixels = static_cast<size_t>(width) * height;
+        if(parent_.size() < pixels) {
+            // Row y holds its runs at [y * width, y * width + runCount[y])
+            runBegin_.resize(pixels);
+            runEnd_.resize(pixels);
+            parent_.resize(pixels);
+            size_.resize(pixels);
+        }
+        runCount_.resize(height);
+        linked_.resize(height);
+
+        // Label the bands, the first row of a band is not merged with the row above yet
+        forEachBand(height, [this, &image](uint32_t y0, uint32_t y1) {
+            for(uint32_t y = y0; y < y1; y++) {
+                buildRuns(image, y);
+                if(y > y0) {
+                    mergeRows(image, y);
+                }
+                linked_[y] = y > y0 ? 1 : 0;
+            }
+        });
+
+        // Merge the seams between the bands
+        for(uint32_t y = 1; y < height; y++) {
+            if(!linked_[y]) {
+                mergeRows(image, y);
+            }
+        }
+
+        // Component sizes, accumulated on the roots
+        for(uint32_t y = 0; y < height; y++) {
+            size_t first = static_cast<size_t>(y) * width;
+            for(size_t run = first; run < first + runCount_[y]; run++) {
+                size_[find(static_cast<uint32_t>(run))] = 0;
+            }
+        }
+        for(uint32_t y = 0; y < height; y++) {
+            size_t first = static_cast<size_t>(y) * width;
+            for(size_t run = first; run < first + runCount_[y]; run++) {
+                size_[find(static_cast<uint32_t>(run))] += runEnd_[run] - runBegin_[run];
+            }
+        }
+
+        // Copy the rows without the small components
+        const uint32_t maxSize = frameParams_.max_size;
+        forEachBand(height, [this, &image, maxSize](uint32_t y0, uint32_t y1) {
+            for(uint32_t y = y0; y < y1; y++) {
+                const uint16_t *src   = image.src + static_cast<size_t>(y) * image.stride;
+                uint16_t       *dst   = image.dst + static_cast<size_t>(y) * image.stride;
+                size_t          first = static_cast<size_t>(y) * image.width;
+                memcpy(dst, src, image.width * sizeof(uint16_t));
+                for(size_t run = first; run < first + runCount_[y]; run++) {
+                    if(size_[root(static_cast<uint32_t>(run))] <= maxSize) {
+                        memset(dst + runBegin_[run], 0, (runEnd_[run] - runBegin_[run]) * sizeof(uint16_t));
+                    }
+                }
+            }
+        });
+    }
+
+private:
+    std::mutex                            paramsMutex_;
+    OBNoiseRemovalFilterParams            params_;
+    OBNoiseRemovalFilterParams            frameParams_;
+    std::shared_ptr<const DisparityTable> table_;
+    std::shared_ptr<const DisparityTable> frameTable_;  // table of the current frame, kept alive while it is processed
+    const uint16_t                       *disparity_;
+    std::vector<uint32_t>                 runBegin_;
+    std::vector<uint32_t>                 runEnd_;
+    std::vector<uint32_t>                 parent_;
+    std::vector<uint32_t>                 size_;
+    std::vector<uint32_t>                 runCount_;
+    std::vector<uint8_t>                  linked_;
+
+    bool connected(uint16_t a, uint16_t b) const {
+        if(a == 0 || b == 0) {
+            return false;
+        }
+        if(disparity_) {
+            a = disparity_[a];
+            b = disparity_[b];
+        }
+        return (a > b ? a - b : b - a) <= frameParams_.disp_diff;
+    }
+
+    // Split row y in runs of horizontally connected valid pixels, each run is its own component
+    void buildRuns(const DepthImage &image, uint32_t y) {
+        const uint16_t *src   = image.src + static_cast<size_t>(y) * image.stride;
+        size_t          first = static_cast<size_t>(y) * image.width;
+        size_t          run   = first;
+        uint32_t        x     = 0;
+        while(x < image.width) {
+            if(src[x] == 0) {
+                x++;
+                continue;
+            }
+            runBegin_[run] = x;
+            for(x++; x < image.width && connected(src[x - 1], src[x]); x++) {}
+            runEnd_[run] = x;
+            parent_[run] = static_cast<uint32_t>(run);
+            run++;
+        }
+        runCount_[y] = static_cast<uint32_t>(run - first);
+    }
+
+    // Union the runs of rows y - 1 and y that have a connected pixel pair
+    void mergeRows(const DepthImage &image, uint32_t y) {
+        const uint16_t *above    = image.src + static_cast<size_t>(y - 1) * image.stride;
+        const uint16_t *below    = image.src + static_cast<size_t>(y) * image.stride;
+        size_t          upper    = static_cast<size_t>(y - 1) * image.width;
+        size_t          upperEnd = upper + runCount_[y - 1];
+        size_t          lower    = static_cast<size_t>(y) * image.width;
+        size_t          lowerEnd = lower + runCount_[y];
+        while(upper < upperEnd && lower < lowerEnd) {
+            uint32_t begin = std::max(runBegin_[upper], runBegin_[lower]);
+            uint32_t end   = std::min(runEnd_[upper], runEnd_[lower]);
+            for(uint32_t x = begin; x < end; x++) {
+                if(connected(above[x], below[x])) {
+                    unite(static_cast<uint32_t>(upper), static_cast<uint32_t>(lower));
+                    break;
+                }
+            }
+            if(runEnd_[upper] < runEnd_[lower]) {
+                upper++;
+            }
+            else {
+                lower++;
+            }
+        }
+    }
+
+    // Root with path halving, only while labelling a band or merging the seams
+    uint32_t find(uint32_t run) {
+        while(parent_[run] != run) {
+            parent_[run] = parent_[parent_[run]];
+            run          = parent_[run];
+        }
+        return run;
+    }
+
+    // Root without writes, safe from several threads once the labelling is done
+    uint32_t root(uint32_t run) const {
+        while(parent_[run] != run) {
+            run = parent_[run];
+        }
+        return run;
+    }
+
+    // Link the larger root under the smaller one
+    void unite(uint32_t a, uint32_t b) {
+        a = find(a);
+        b = find(b);
+        if(a < b) {
+            parent_[b] = a;
+        }
+        else if(b < a) {
+            parent_[a] = b;
+        }
+    }
+};
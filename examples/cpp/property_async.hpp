@@ -0,0 +1,250 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+#include "property_batch.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Non-blocking access to the primary type (bool, int and float) properties of one device.
+//
+// The ob::Device property accessors block for the duration of the command round trip. AsyncPropertyQueue serves the
+// requests on its own thread in submission order, so they can be issued from a frame callback or a control loop without
+// stalling it. Each request completes through a std::future or a completion callback called on the queue thread, a callback
+// must not call flush() or wait on a future of the same queue.
+//
+// A request is coalesced with the last pending request when both are on the same property: a write that directly follows a
+// not yet executed write replaces its value, and a read that directly follows a not yet executed read shares its result.
+// Only the last value of a burst of writes (e.g. an exposure control loop running at frame rate) is sent to the device,
+// every request still completes. Requests are never merged across a request on another property, so the order across
+// properties is kept (e.g. an exposure written between turning auto exposure off and on again).
+// post() runs a task in the same order, for the read-modify-write sequences that need several accesses in a row.
+// An exception thrown by a completion callback or a task is dropped, the queue thread keeps running.
+class AsyncPropertyQueue {
+public:
+    typedef std::function<void(const PropertyResult &result)> CompletionCallback;
+    typedef std::function<void(std::shared_ptr<ob::Device> device)> Task;
+
+    explicit AsyncPropertyQueue(std::shared_ptr<ob::Device> device) : device_(device), stop_(false), busy_(false), coalesced_(0) {
+        worker_ = std::thread(&AsyncPropertyQueue::run, this);
+    }
+
+    // The pending requests are still executed, so that every future and callback completes
+    ~AsyncPropertyQueue() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        requestCv_.notify_all();
+        worker_.join();
+    }
+
+    std::future<PropertyResult> setBoolProperty(OBPropertyID id, bool value) {
+        return toFuture([this, id, value](CompletionCallback callback) { setBoolProperty(id, value, callback); });
+    }
+
+    void setBoolProperty(OBPropertyID id, bool value, CompletionCallback callback) {
+        PropertyValue item;
+        item.id        = id;
+        item.type      = OB_BOOL_PROPERTY;
+        item.boolValue = value;
+        submit(item, true, callback);
+    }
+
+    std::future<PropertyResult> setIntProperty(OBPropertyID id, int32_t value) {
+        return toFuture([this, id, value](CompletionCallback callback) { setIntProperty(id, value, callback); });
+    }
+
+    void setIntProperty(OBPropertyID id, int32_t value, CompletionCallback callback) {
+        PropertyValue item;
+        item.id       = id;
+        item.type     = OB_INT_PROPERTY;
+        item.intValue = value;
+        submit(item, true, callback);
+    }
+
+    std::future<PropertyResult> setFloatProperty(OBPropertyID id, float value) {
+        return toFuture([this, id, value](CompletionCallback callback) { setFloatProperty(id, value, callback); });
+    }
+
+    void setFloatProperty(OBPropertyID id, float value, CompletionCallback callback) {
+        PropertyValue item;
+        item.id         = id;
+        item.type       = OB_FLOAT_PROPERTY;
+        item.floatValue = value;
+        submit(item, true, callback);
+    }
+
+    // Read a property, the value is returned in PropertyResult::value
+    std::future<PropertyResult> getProperty(OBPropertyID id, OBPropertyType type) {
+        return toFuture([this, id, type](CompletionCallback callback) { getProperty(id, type, callback); });
+    }
+
+    void getProperty(OBPropertyID id, OBPropertyType type, CompletionCallback callback) {
+        PropertyValue item;
+        item.id       = id;
+        item.type     = type;
+        item.intValue = 0;
+        submit(item, false, callback);
+    }
+
+    // Run task on the queue thread once the requests submitted before are completed, the requests submitted after it wait for
+    // it. The task calls the device directly, an error it does not handle is dropped. Requests are never merged across a task.
+    void post(Task task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto                        request = std::make_shared<Request>();
+            request->isWrite                    = false;
+            request->task                       = task;
+            queue_.push_back(request);
+        }
+        requestCv_.notify_one();
+    }
+
+    // Block until every request submitted so far is completed
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idleCv_.wait(lock, [this]() { return queue_.empty() && !busy_; });
+    }
+
+    size_t pendingCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.size();
+    }
+
+    // Number of requests merged into a pending request of the same property
+    uint64_t coalescedCount() const {
+        return coalesced_;
+    }
+
+private:
+    struct Request {
+        PropertyValue                   value;
+        bool                            isWrite;
+        std::vector<CompletionCallback> callbacks;
+        Task                            task;
+    };
+
+    std::shared_ptr<ob::Device>          device_;
+    std::deque<std::shared_ptr<Request>> queue_;
+    mutable std::mutex                   mutex_;
+    std::condition_variable              requestCv_;
+    std::condition_variable              idleCv_;
+    bool                                 stop_;
+    bool                                 busy_;
+    std::atomic<uint64_t>                coalesced_;
+    std::thread                          worker_;
+
+    template <typename Submit> static std::future<PropertyResult> toFuture(Submit submit) {
+        auto promise = std::make_shared<std::promise<PropertyResult>>();
+        auto future  = promise->get_future();
+        submit([promise](const PropertyResult &result) { promise->set_value(result); });
+        return future;
+    }
+
+    void submit(const PropertyValue &value, bool isWrite, CompletionCallback callback) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // Merging is only done with the last queued request, so no request moves across another one
+            auto last = queue_.empty() ? nullptr : queue_.back();
+            if(last && !last->task && last->value.id == value.id && last->isWrite == isWrite && last->value.type == value.type) {
+                if(isWrite) {
+                    last->value = value;
+                }
+                last->callbacks.push_back(callback);
+                coalesced_++;
+                return;
+            }
+
+            auto request     = std::make_shared<Request>();
+            request->value   = value;
+            request->isWrite = isWrite;
+            request->callbacks.push_back(callback);
+            queue_.push_back(request);
+        }
+        requestCv_.notify_one();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(true) {
+            requestCv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+            if(queue_.empty()) {
+                break;  // stopped and drained
+            }
+
+            auto request = queue_.front();
+            queue_.pop_front();
+            busy_ = true;
+            lock.unlock();
+
+            if(request->task) {
+                runTask(request->task);
+            }
+            else {
+                execute(*request);
+            }
+
+            lock.lock();
+            busy_ = false;
+            if(queue_.empty()) {
+                idleCv_.notify_all();
+            }
+        }
+    }
+
+    void runTask(const Task &task) {
+        try {
+            task(device_);
+        }
+        catch(...) {
+        }
+    }
+
+    void execute(const Request &request) {
+        PropertyResult result;
+        result.value   = request.value;
+        result.isWrite = request.isWrite;
+        result.status  = OB_STATUS_OK;
+        try {
+            if(result.isWrite) {
+                writePropertyValue(device_, result.value);
+            }
+            else {
+                readPropertyValue(device_, result.value);
+            }
+        }
+        catch(ob::Error &e) {
+            result.status  = OB_STATUS_ERROR;
+            result.message = e.getMessage();
+        }
+        catch(std::exception &e) {
+            result.status  = OB_STATUS_ERROR;
+            result.message = e.what();
+        }
+        catch(...) {
+            result.status  = OB_STATUS_ERROR;
+            result.message = "unknown error";
+        }
+
+        for(auto &callback: request.callbacks) {
+            if(!callback) {
+                continue;
+            }
+            try {
+                callback(result);
+            }
+            catch(...) {
+            }
+        }
+    }
+};
@@ -0,0 +1,243 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Value of a primary type (bool, int or float) device property
+struct PropertyValue {
+    OBPropertyID   id;
+    OBPropertyType type;
+    union {
+        bool    boolValue;
+        int32_t intValue;
+        float   floatValue;
+    };
+};
+
+// Result of one item of a property batch
+struct PropertyResult {
+    PropertyValue value;    // value written, or value read back for get items
+    bool          isWrite;  // true for set items, false for get items
+    OBStatus      status;   // OB_STATUS_OK on success
+    std::string   message;  // error message when status is OB_STATUS_ERROR
+};
+
+// Write a primary type property value to the device, ob::Error is thrown on failure
+inline void writePropertyValue(std::shared_ptr<ob::Device> &device, const PropertyValue &value) {
+    switch(value.type) {
+    case OB_BOOL_PROPERTY:
+        device->setBoolProperty(value.id, value.boolValue);
+        break;
+    case OB_INT_PROPERTY:
+        device->setIntProperty(value.id, value.intValue);
+        break;
+    case OB_FLOAT_PROPERTY:
+        device->setFloatProperty(value.id, value.floatValue);
+        break;
+    default:
+        break;
+    }
+}
+
+// Read a primary type property value from the device into value, ob::Error is thrown on failure
+inline void readPropertyValue(std::shared_ptr<ob::Device> &device, PropertyValue &value) {
+    switch(value.type) {
+    case OB_BOOL_PROPERTY:
+        value.boolValue = device->getBoolProperty(value.id);
+        break;
+    case OB_INT_PROPERTY:
+        value.intValue = device->getIntProperty(value.id);
+        break;
+    case OB_FLOAT_PROPERTY:
+        value.floatValue = device->getFloatProperty(value.id);
+        break;
+    default:
+        break;
+    }
+}
+
+// Batch of property reads and writes applied with a single call.
+//
+// Items are applied in queue order and each item reports its own status, a failing item does not abort the batch.
+// A write directly following a write of the same property replaces its value, so only the last value is sent. Writes are
+// never moved past the items of other properties, so the order across properties is kept for the properties that depend
+// on each other (e.g. an exposure written while auto exposure is off). The support of every
+// property is checked against the supported property table read once per commit instead of one isPropertySupported()
+// request per item.
+// Committing on several devices runs the devices concurrently, so applying a profile to a rig costs the time of the
+// slowest device instead of the sum of all devices.
+class PropertyBatch {
+public:
+    PropertyBatch &setBool(OBPropertyID id, bool value) {
+        PropertyValue item;
+        item.id        = id;
+        item.type      = OB_BOOL_PROPERTY;
+        item.boolValue = value;
+        return queue(item, true);
+    }
+
+    PropertyBatch &setInt(OBPropertyID id, int32_t value) {
+        PropertyValue item;
+        item.id       = id;
+        item.type     = OB_INT_PROPERTY;
+        item.intValue = value;
+        return queue(item, true);
+    }
+
+    PropertyBatch &setFloat(OBPropertyID id, float value) {
+        PropertyValue item;
+        item.id         = id;
+        item.type       = OB_FLOAT_PROPERTY;
+        item.floatValue = value;
+        return queue(item, true);
+    }
+
+    PropertyBatch &get(OBPropertyID id, OBPropertyType type) {
+        PropertyValue item;
+        item.id       = id;
+        item.type     = type;
+        item.intValue = 0;
+        return queue(item, false);
+    }
+
+    size_t size() const {
+        return items_.size();
+    }
+
+    void clear() {
+        items_.clear();
+    }
+
+    typedef std::map<OBPropertyID, OBPropertyItem> PropertyTable;
+
+    // Read the supported property table of the device, an empty table is returned if it can not be read
+    static PropertyTable readPropertyTable(std::shared_ptr<ob::Device> device) {
+        PropertyTable table;
+        try {
+            uint32_t count = device->getSupportedPropertyCount();
+            for(uint32_t i = 0; i < count; i++) {
+                auto item      = device->getSupportedProperty(i);
+                table[item.id] = item;
+            }
+        }
+        catch(ob::Error &) {
+            table.clear();
+        }
+        return table;
+    }
+
+    // Apply the batch on one device, the results are in queue order (consecutive writes of one property give one result).
+    std::vector<PropertyResult> commit(std::shared_ptr<ob::Device> device) const {
+        return commit(device, readPropertyTable(device));
+    }
+
+    // Apply the batch with a supported property table already read from the device.
+    // If the table is empty, each item is checked with Device::isPropertySupported() instead.
+    std::vector<PropertyResult> commit(std::shared_ptr<ob::Device> device, const PropertyTable &table) const {
+        std::vector<PropertyResult> results;
+        results.reserve(items_.size());
+
+        for(size_t i = 0; i < items_.size(); i++) {
+            PropertyResult result;
+            result.value   = items_[i].value;
+            result.isWrite = items_[i].isWrite;
+            result.status  = OB_STATUS_OK;
+
+            OBPermissionType required = result.isWrite ? OB_PERMISSION_WRITE : OB_PERMISSION_READ;
+            if(!isSupported(device, table, result.value.id, required)) {
+                result.status  = OB_STATUS_ERROR;
+                result.message = "property is not supported";
+                results.push_back(result);
+                continue;
+            }
+
+            try {
+                if(result.isWrite) {
+                    writePropertyValue(device, result.value);
+                }
+                else {
+                    readPropertyValue(device, result.value);
+                }
+            }
+            catch(ob::Error &e) {
+                result.status  = OB_STATUS_ERROR;
+                result.message = e.getMessage();
+            }
+            results.push_back(result);
+        }
+        return results;
+    }
+
+    // Apply the batch on several devices concurrently, results[i] belongs to devices[i].
+    std::vector<std::vector<PropertyResult>> commit(const std::vector<std::shared_ptr<ob::Device>> &devices) const {
+        std::vector<std::vector<PropertyResult>> results(devices.size());
+        std::vector<std::thread>                 threads;
+        for(size_t i = 0; i < devices.size(); i++) {
+            threads.emplace_back([this, &devices, &results, i]() { results[i] = commit(devices[i]); });
+        }
+        for(auto &thread: threads) {
+            thread.join();
+        }
+        return results;
+    }
+
+private:
+    struct Item {
+        PropertyValue value;
+        bool          isWrite;
+    };
+
+    std::vector<Item> items_;
+
+    PropertyBatch &queue(const PropertyValue &value, bool isWrite) {
+        // A write overwritten by the next item can not be observed, only the last value is sent
+        if(isWrite && !items_.empty() && items_.back().isWrite && items_.back().value.id == value.id) {
+            items_.back().value = value;
+            return *this;
+        }
+
+        Item item;
+        item.value   = value;
+        item.isWrite = isWrite;
+        items_.push_back(item);
+        return *this;
+    }
+
+    static bool isSupported(std::shared_ptr<ob::Device> &device, const PropertyTable &table, OBPropertyID id, OBPermissionType required) {
+        if(table.empty()) {
+            try {
+                return device->isPropertySupported(id, required);
+            }
+            catch(ob::Error &) {
+                return false;
+            }
+        }
+
+        auto iter = table.find(id);
+        if(iter == table.end()) {
+            return false;
+        }
+        return iter->second.permission == OB_PERMISSION_READ_WRITE || iter->second.permission == required;
+    }
+};
+
+// Read every readable primary type property of the device with one batch, e.g. to snapshot the device settings
+// next to Device::exportSettingsAsPresetJsonData().
+inline std::vector<PropertyResult> readAllProperties(std::shared_ptr<ob::Device> device) {
+    PropertyBatch batch;
+    auto          table = PropertyBatch::readPropertyTable(device);
+    for(auto &entry: table) {
+        const OBPropertyItem &item = entry.second;
+        if(item.type == OB_STRUCT_PROPERTY || (item.permission != OB_PERMISSION_READ && item.permission != OB_PERMISSION_READ_WRITE)) {
+            continue;
+        }
+        batch.get(item.id, item.type);
+    }
+    return batch.commit(device, table);
+}
@@ -0,0 +1,375 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+#include "property_batch.hpp"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Opt-in host side cache of device properties.
+//
+// Every ob::Device property query is a command round trip to the device, which competes with the streaming control traffic.
+// PropertyCache answers from host memory:
+//  - static data: the supported property table, isPropertySupported(), the min/max/step/def of the property ranges and
+//    OBCmdVersion. get*PropertyRange() reads the cur field from the device on every call, get*PropertyLimits() skips it;
+//  - the value of the property the host last wrote through the cache, as read back from the device after the write (the
+//    device may clamp or round the value to its step).
+// A write may change other properties (e.g. the exposure when auto exposure is toggled), so it drops the values cached for
+// all the other properties. Values that were not written through the cache are always read from the device, since the
+// device may change them by itself (auto exposure, ...). Do not write through the cache the properties the device updates
+// on its own.
+//
+// The cache is invalidated on reboot(), on preset loading and when the device reports a state change. invalidate() can be
+// called at any time, e.g. after the device settings were changed by another process.
+class PropertyCache {
+public:
+    explicit PropertyCache(std::shared_ptr<ob::Device> device) : device_(device), state_(std::make_shared<State>()) {
+        // Any device state change (reconnection, overheat frame rate reduction, ...) may change the device settings
+        std::weak_ptr<State> weakState = state_;
+        device_->setDeviceStateChangedCallback([weakState](OBDeviceState deviceState, const char *message) {
+            auto state = weakState.lock();
+            if(!state) {
+                return;
+            }
+            state->clear();
+
+            DeviceStateChangedCallback callback;
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                callback = state->stateChangedCallback;
+            }
+            if(callback) {
+                callback(deviceState, message);
+            }
+        });
+    }
+
+    std::shared_ptr<ob::Device> device() const {
+        return device_;
+    }
+
+    // The cache owns the device state changed callback of the device, register the application callback here.
+    void setDeviceStateChangedCallback(DeviceStateChangedCallback callback) {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->stateChangedCallback = callback;
+    }
+
+    uint32_t getSupportedPropertyCount() {
+        loadPropertyList();
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        return static_cast<uint32_t>(state_->list.size());
+    }
+
+    OBPropertyItem getSupportedProperty(uint32_t index) {
+        loadPropertyList();
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            if(index < state_->list.size()) {
+                return state_->list[index];
+            }
+        }
+        // Out of range index, let the SDK report the error
+        return device_->getSupportedProperty(index);
+    }
+
+    bool isPropertySupported(OBPropertyID propertyId, OBPermissionType permission) {
+        auto     key = std::make_pair(propertyId, permission);
+        uint64_t generation;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            auto                        iter = state_->supported.find(key);
+            if(iter != state_->supported.end()) {
+                state_->hits++;
+                return iter->second;
+            }
+            generation = state_->generation;
+        }
+
+        bool supported = device_->isPropertySupported(propertyId, permission);
+        state_->misses++;
+
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if(generation == state_->generation) {
+            state_->supported[key] = supported;
+        }
+        return supported;
+    }
+
+    OBIntPropertyRange getIntPropertyRange(OBPropertyID propertyId) {
+        auto range = getIntPropertyLimits(propertyId);
+        range.cur  = device_->getIntProperty(propertyId);
+        return range;
+    }
+
+    OBFloatPropertyRange getFloatPropertyRange(OBPropertyID propertyId) {
+        auto range = getFloatPropertyLimits(propertyId);
+        range.cur  = device_->getFloatProperty(propertyId);
+        return range;
+    }
+
+    OBBoolPropertyRange getBoolPropertyRange(OBPropertyID propertyId) {
+        auto range = getBoolPropertyLimits(propertyId);
+        range.cur  = device_->getBoolProperty(propertyId);
+        return range;
+    }
+
+    // min/max/step/def of a property from the cache only, cur is not read from the device and holds def
+    OBIntPropertyRange getIntPropertyLimits(OBPropertyID propertyId) {
+        return getLimits(state_->intRanges, propertyId, [this, propertyId]() { return device_->getIntPropertyRange(propertyId); });
+    }
+
+    OBFloatPropertyRange getFloatPropertyLimits(OBPropertyID propertyId) {
+        return getLimits(state_->floatRanges, propertyId, [this, propertyId]() { return device_->getFloatPropertyRange(propertyId); });
+    }
+
+    OBBoolPropertyRange getBoolPropertyLimits(OBPropertyID propertyId) {
+        return getLimits(state_->boolRanges, propertyId, [this, propertyId]() { return device_->getBoolPropertyRange(propertyId); });
+    }
+
+    OBCmdVersion getCmdVersion(OBPropertyID propertyId) {
+        uint64_t generation;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            auto                        iter = state_->cmdVersions.find(propertyId);
+            if(iter != state_->cmdVersions.end()) {
+                state_->hits++;
+                return iter->second;
+            }
+            generation = state_->generation;
+        }
+
+        OBCmdVersion version = device_->getCmdVersion(propertyId);
+        state_->misses++;
+
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if(generation == state_->generation) {
+            state_->cmdVersions[propertyId] = version;
+        }
+        return version;
+    }
+
+    // The write costs one more round trip, to read back the value the device applied
+    void setIntProperty(OBPropertyID propertyId, int32_t value) {
+        PropertyValue applied;
+        applied.id       = propertyId;
+        applied.type     = OB_INT_PROPERTY;
+        applied.intValue = value;
+        writeAndStore(applied);
+    }
+
+    void setFloatProperty(OBPropertyID propertyId, float value) {
+        PropertyValue applied;
+        applied.id         = propertyId;
+        applied.type       = OB_FLOAT_PROPERTY;
+        applied.floatValue = value;
+        writeAndStore(applied);
+    }
+
+    void setBoolProperty(OBPropertyID propertyId, bool value) {
+        PropertyValue applied;
+        applied.id        = propertyId;
+        applied.type      = OB_BOOL_PROPERTY;
+        applied.boolValue = value;
+        writeAndStore(applied);
+    }
+
+    int32_t getIntProperty(OBPropertyID propertyId) {
+        PropertyValue value;
+        if(findWrittenValue(propertyId, value)) {
+            return value.intValue;
+        }
+        return device_->getIntProperty(propertyId);
+    }
+
+    float getFloatProperty(OBPropertyID propertyId) {
+        PropertyValue value;
+        if(findWrittenValue(propertyId, value)) {
+            return value.floatValue;
+        }
+        return device_->getFloatProperty(propertyId);
+    }
+
+    bool getBoolProperty(OBPropertyID propertyId) {
+        PropertyValue value;
+        if(findWrittenValue(propertyId, value)) {
+            return value.boolValue;
+        }
+        return device_->getBoolProperty(propertyId);
+    }
+
+    void reboot() {
+        device_->reboot();
+        invalidate();
+    }
+
+    void reboot(uint32_t delayMs) {
+        device_->reboot(delayMs);
+        invalidate();
+    }
+
+    void loadPreset(const char *presetName) {
+        device_->loadPreset(presetName);
+        invalidate();
+    }
+
+    void loadPresetFromJsonFile(const char *filePath) {
+        device_->loadPresetFromJsonFile(filePath);
+        invalidate();
+    }
+
+    void loadPresetFromJsonData(const char *presetName, const uint8_t *data, uint32_t size) {
+        device_->loadPresetFromJsonData(presetName, data, size);
+        invalidate();
+    }
+
+    // Drop everything, the next queries are read from the device again
+    void invalidate() {
+        state_->clear();
+    }
+
+    // Drop the cached data of one property
+    void invalidate(OBPropertyID propertyId) {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->generation++;
+        state_->values.erase(propertyId);
+        state_->intRanges.erase(propertyId);
+        state_->floatRanges.erase(propertyId);
+        state_->boolRanges.erase(propertyId);
+        state_->cmdVersions.erase(propertyId);
+        for(auto iter = state_->supported.begin(); iter != state_->supported.end();) {
+            iter = iter->first.first == propertyId ? state_->supported.erase(iter) : std::next(iter);
+        }
+    }
+
+    uint64_t hitCount() const {
+        return state_->hits;
+    }
+
+    uint64_t missCount() const {
+        return state_->misses;
+    }
+
+private:
+    struct State {
+        std::mutex                                                mutex;
+        bool                                                      listValid = false;
+        std::vector<OBPropertyItem>                               list;
+        std::map<std::pair<OBPropertyID, OBPermissionType>, bool> supported;
+        std::map<OBPropertyID, OBIntPropertyRange>                intRanges;
+        std::map<OBPropertyID, OBFloatPropertyRange>              floatRanges;
+        std::map<OBPropertyID, OBBoolPropertyRange>               boolRanges;
+        std::map<OBPropertyID, OBCmdVersion>                      cmdVersions;
+        std::map<OBPropertyID, PropertyValue>                     values;
+        DeviceStateChangedCallback                                stateChangedCallback;
+        std::atomic<uint64_t>                                     hits{ 0 };
+        std::atomic<uint64_t>                                     misses{ 0 };
+        // Bumped on every invalidation and every write, a query started before it does not store its result
+        uint64_t generation = 0;
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            generation++;
+            listValid = false;
+            list.clear();
+            supported.clear();
+            intRanges.clear();
+            floatRanges.clear();
+            boolRanges.clear();
+            cmdVersions.clear();
+            values.clear();
+        }
+    };
+
+    std::shared_ptr<ob::Device> device_;
+    std::shared_ptr<State>      state_;
+
+    void loadPropertyList() {
+        uint64_t generation;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            if(state_->listValid) {
+                state_->hits++;
+                return;
+            }
+            generation = state_->generation;
+        }
+
+        std::vector<OBPropertyItem> list;
+        uint32_t                    count = device_->getSupportedPropertyCount();
+        for(uint32_t i = 0; i < count; i++) {
+            list.push_back(device_->getSupportedProperty(i));
+        }
+        state_->misses++;
+
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if(generation == state_->generation) {
+            state_->list      = list;
+            state_->listValid = true;
+        }
+    }
+
+    // Only the limits are kept, the current value of a range goes stale as soon as the property changes
+    template <typename Range, typename Query> Range getLimits(std::map<OBPropertyID, Range> &ranges, OBPropertyID propertyId, Query query) {
+        uint64_t generation;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            auto                        iter = ranges.find(propertyId);
+            if(iter != ranges.end()) {
+                state_->hits++;
+                return iter->second;
+            }
+            generation = state_->generation;
+        }
+
+        Range range = query();
+        range.cur   = range.def;
+        state_->misses++;
+
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if(generation == state_->generation) {
+            ranges[propertyId] = range;
+        }
+        return range;
+    }
+
+    // Write value, then cache the value read back from the device. The write starts a new generation, so a value read back
+    // before a later write or invalidation is not stored.
+    void writeAndStore(PropertyValue value) {
+        uint64_t generation;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            state_->values.clear();
+            generation = ++state_->generation;
+        }
+
+        writePropertyValue(device_, value);
+        try {
+            readPropertyValue(device_, value);
+        }
+        catch(ob::Error &) {
+            return;  // e.g. a write only property, nothing is cached
+        }
+
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if(generation == state_->generation) {
+            state_->values[value.id] = value;
+        }
+    }
+
+    bool findWrittenValue(OBPropertyID propertyId, PropertyValue &value) {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        auto                        iter = state_->values.find(propertyId);
+        if(iter == state_->values.end()) {
+            state_->misses++;
+            return false;
+        }
+        state_->hits++;
+        value = iter->second;
+        return true;
+    }
+};
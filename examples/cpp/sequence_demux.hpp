@@ -0,0 +1,157 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+#include "frame_delivery.hpp"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Frames of one sequence id seen by a SequenceDemux
+struct SequenceStats {
+    uint32_t sequence;
+    uint64_t frames;     // frames received, routed or not
+    uint64_t routed;     // frames given to the route of the sequence
+    double   frameRate;  // frames per second, from the device timestamps of the recent frames
+    uint64_t lastIndex;  // index of the last frame
+};
+
+// Routes the frames of an interleaved HDR / sequence id stream by OB_FRAME_METADATA_TYPE_HDR_SEQUENCE_INDEX.
+//
+// Each frame is read once and handed to the route of its sequence id as is, the frame is not copied and the other routes
+// never see it, where a SequenceIdFilter per id would process every frame. A route is a callback run on the dispatching
+// thread, or a FrameDeliveryThread that queues the frame for its own thread. A frame set is routed as a whole by the sequence
+// id of its depth frame (or of its first frame carrying one), so the frames of one exposure stay together.
+// Frames without sequence id go to the default route when there is one. The routes must be set before the stream is started,
+// the statistics can be read from any thread.
+class SequenceDemux {
+public:
+    SequenceDemux() : unsequenced_(0) {}
+
+    void route(uint32_t sequence, ob::FrameCallback callback) {
+        routes_[sequence] = callback;
+    }
+
+    void route(uint32_t sequence, std::shared_ptr<FrameDeliveryThread> thread) {
+        routes_[sequence] = [thread](std::shared_ptr<ob::Frame> frame) { thread->push(frame); };
+    }
+
+    // Route of the frames without sequence id
+    void setDefaultRoute(ob::FrameCallback callback) {
+        defaultRoute_ = callback;
+    }
+
+    void dispatch(std::shared_ptr<ob::Frame> frame) {
+        if(frame == nullptr) {
+            return;
+        }
+        auto carrier = sequenceFrame(frame);
+        if(carrier == nullptr) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                unsequenced_++;
+            }
+            if(defaultRoute_) {
+                defaultRoute_(frame);
+            }
+            return;
+        }
+
+        uint32_t sequence = static_cast<uint32_t>(carrier->getMetadataValue(OB_FRAME_METADATA_TYPE_HDR_SEQUENCE_INDEX));
+        auto     iter     = routes_.find(sequence);
+        bool     routed   = iter != routes_.end() && iter->second;
+        count(sequence, carrier, routed);
+        if(routed) {
+            iter->second(frame);
+        }
+    }
+
+    // Callback for Pipeline::start(config, callback)
+    ob::FrameSetCallback frameSetCallback() {
+        return [this](std::shared_ptr<ob::FrameSet> frameSet) { dispatch(frameSet); };
+    }
+
+    // Callback for Sensor::start(profile, callback)
+    ob::FrameCallback frameCallback() {
+        return [this](std::shared_ptr<ob::Frame> frame) { dispatch(frame); };
+    }
+
+    // Statistics of the sequence ids seen so far, in sequence id order
+    std::vector<SequenceStats> stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<SequenceStats>  result;
+        for(auto &entry: counters_) {
+            SequenceStats stats;
+            stats.sequence  = entry.first;
+            stats.frames    = entry.second.frames;
+            stats.routed    = entry.second.routed;
+            stats.frameRate = entry.second.interval > 0 ? 1000000.0 / entry.second.interval : 0;
+            stats.lastIndex = entry.second.lastIndex;
+            result.push_back(stats);
+        }
+        return result;
+    }
+
+    // Frames without sequence id
+    uint64_t unsequencedCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return unsequenced_;
+    }
+
+private:
+    struct Counter {
+        uint64_t frames;
+        uint64_t routed;
+        uint64_t lastTimestampUs;
+        uint64_t lastIndex;
+        double   interval;  // moving average of the time between two frames, microseconds
+    };
+
+    std::map<uint32_t, ob::FrameCallback> routes_;
+    ob::FrameCallback                     defaultRoute_;
+    mutable std::mutex                    mutex_;
+    std::map<uint32_t, Counter>           counters_;
+    uint64_t                              unsequenced_;
+
+    // Frame carrying the sequence id: the frame itself, or the depth frame (else the first frame with one) of a frame set.
+    // nullptr when there is none.
+    static std::shared_ptr<ob::Frame> sequenceFrame(std::shared_ptr<ob::Frame> frame) {
+        if(frame->type() != OB_FRAME_SET) {
+            return frame->hasMetadata(OB_FRAME_METADATA_TYPE_HDR_SEQUENCE_INDEX) ? frame : nullptr;
+        }
+        auto frameSet = frame->as<ob::FrameSet>();
+        auto depth    = frameSet->depthFrame();
+        if(depth && depth->hasMetadata(OB_FRAME_METADATA_TYPE_HDR_SEQUENCE_INDEX)) {
+            return depth;
+        }
+        for(uint32_t i = 0; i < frameSet->frameCount(); i++) {
+            auto member = frameSet->getFrame(static_cast<int>(i));
+            if(member && member->hasMetadata(OB_FRAME_METADATA_TYPE_HDR_SEQUENCE_INDEX)) {
+                return member;
+            }
+        }
+        return nullptr;
+    }
+
+    void count(uint32_t sequence, std::shared_ptr<ob::Frame> frame, bool routed) {
+        uint64_t                    timestampUs = frame->timeStampUs();
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto                        iter = counters_.find(sequence);
+        if(iter == counters_.end()) {
+            Counter counter = { 0, 0, timestampUs, frame->index(), 0 };
+            iter            = counters_.insert(std::make_pair(sequence, counter)).first;
+        }
+        Counter &counter = iter->second;
+        if(counter.frames > 0 && timestampUs > counter.lastTimestampUs) {
+            double interval  = static_cast<double>(timestampUs - counter.lastTimestampUs);
+            counter.interval = counter.interval > 0 ? counter.interval * 0.9 + interval * 0.1 : interval;
+        }
+        counter.frames++;
+        counter.routed += routed ? 1 : 0;
+        counter.lastTimestampUs = timestampUs;
+        counter.lastIndex       = frame->index();
+    }
+};
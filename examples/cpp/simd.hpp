@@ -0,0 +1,53 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+// Instruction sets available to the host side frame processing of the examples.
+//
+// The kernels are written for the baseline vector unit of each architecture (SSE2 on x86-64, NEON on AArch64 and ARMv7 with
+// NEON) so that the examples run on any CPU of the platform. The scalar paths are written to be auto-vectorized: building
+// with -march=native (or -mavx2) lets the compiler widen them further.
+// The byte shuffles of SSSE3 are the exception, selected at runtime: the kernels marked OB_EXAMPLES_TARGET_SSSE3 are
+// compiled for SSSE3 whatever the target of the build, and only called when cpuSupportsSsse3() (always true when the build
+// enables SSSE3).
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OB_EXAMPLES_SSE2 1
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#define OB_EXAMPLES_SSSE3 1
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OB_EXAMPLES_NEON 1
+#endif
+
+#if defined(OB_EXAMPLES_SSE2)
+#if defined(OB_EXAMPLES_SSSE3)
+#define OB_EXAMPLES_SSSE3_KERNEL 1
+#define OB_EXAMPLES_TARGET_SSSE3
+inline bool cpuSupportsSsse3() {
+    return true;
+}
+#elif defined(__GNUC__) || defined(__clang__)
+#include <tmmintrin.h>
+#define OB_EXAMPLES_SSSE3_KERNEL 1
+#define OB_EXAMPLES_TARGET_SSSE3 __attribute__((target("ssse3")))
+inline bool cpuSupportsSsse3() {
+    static const bool supported = __builtin_cpu_supports("ssse3") != 0;
+    return supported;
+}
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#include <tmmintrin.h>
+#define OB_EXAMPLES_SSSE3_KERNEL 1
+#define OB_EXAMPLES_TARGET_SSSE3
+inline bool cpuSupportsSsse3() {
+    static const bool supported = []() {
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0;  // ECX bit 9
+    }();
+    return supported;
+}
+#endif
+#endif
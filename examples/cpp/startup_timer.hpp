@@ -0,0 +1,74 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include <chrono>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Timing report of the startup phases of an application, from its construction to the first frame.
+//
+// Call mark() at the end of each phase (context creation, device open, stream start, first frame, ...). Marking the same
+// phase again is ignored, so mark() can be called from a frame callback for every frame. report() prints the duration of
+// each phase and the cumulated time since construction.
+class StartupTimer {
+public:
+    StartupTimer() : start_(std::chrono::steady_clock::now()) {}
+
+    // Record the end of a phase, returns false if the phase was already recorded
+    bool mark(const std::string &phase) {
+        auto                        now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(auto &mark: marks_) {
+            if(mark.phase == phase) {
+                return false;
+            }
+        }
+        marks_.push_back({ phase, now });
+        return true;
+    }
+
+    bool hasMark(const std::string &phase) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(auto &mark: marks_) {
+            if(mark.phase == phase) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Time from construction to the end of the last recorded phase, in milliseconds
+    double elapsedMs() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return marks_.empty() ? 0 : toMs(marks_.back().time - start_);
+    }
+
+    void report(std::ostream &os) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        os << "Startup timing:" << std::endl;
+        auto last = start_;
+        for(auto &mark: marks_) {
+            os << "    " << std::left << std::setw(24) << mark.phase << std::right << std::fixed << std::setprecision(1) << std::setw(9)
+               << toMs(mark.time - last) << " ms" << std::setw(11) << toMs(mark.time - start_) << " ms total" << std::endl;
+            last = mark.time;
+        }
+        os.unsetf(std::ios_base::floatfield);
+    }
+
+private:
+    struct Mark {
+        std::string                           phase;
+        std::chrono::steady_clock::time_point time;
+    };
+
+    static double toMs(std::chrono::steady_clock::duration duration) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 1000.0;
+    }
+
+    std::chrono::steady_clock::time_point start_;
+    std::vector<Mark>                     marks_;
+    mutable std::mutex                    mutex_;
+};
@@ -0,0 +1,211 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "depth_filter.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <vector>
+
+// Host side temporal filter: exponential smoothing of the depth over time, with optional persistence of the last valid
+// depth on pixels that lose their depth for a few frames.
+//
+// A pixel is smoothed when its depth differs from the previous filtered depth by at most diffScale times the previous depth:
+// out = prev + weight * (cur - prev). Larger differences are treated as motion and take the current depth as is.
+// The history is the previous filtered frame in Y16, updated in place by the kernel, and one byte per pixel holding the
+// validity of the last 8 frames as bits for the persistence. No float copy of the frame is made.
+// The history is reset when the resolution or the region of interest changes, call reset() when the scene changes (stream
+// restart, camera moved).
+class HostTemporalFilter : public DepthFilter {
+public:
+    explicit HostTemporalFilter(std::shared_ptr<Executor> executor = nullptr) : DepthFilter(executor) {
+        region_.x      = 0;
+        region_.y      = 0;
+        region_.width  = 0;
+        region_.height = 0;
+        frameWidth_    = 0;
+        frameHeight_   = 0;
+        setDiffScale(0.1f);
+        setWeight(0.4f);
+        setPersistence(0, 0);
+    }
+
+    const char *type() const override {
+        return "HostTemporalFilter";
+    }
+
+    // Largest depth change smoothed, relative to the previous depth, in [0, 1]
+    void setDiffScale(float diffScale) {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        params_.diffScale = toQ16(diffScale);
+    }
+
+    // Weight of the current frame in [0, 1], 1 disables the smoothing
+    void setWeight(float weight) {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        params_.weight = toQ16(weight);
+        params_.smooth = weight < 1.0f;
+    }
+
+    // Keep the last depth of a pixel that became invalid when it was valid in at least validCount of the last historyLength
+    // frames (historyLength <= 8), e.g. (2, 3), (1, 8), (8, 8). historyLength = 0 disables the persistence, validCount = 0
+    // keeps the last depth forever.
+    void setPersistence(uint32_t validCount, uint32_t historyLength) {
+        historyLength = std::min(historyLength, 8u);
+        validCount    = std::min(validCount, historyLength);
+
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        params_.persistence = historyLength > 0;
+        for(uint32_t bits = 0; bits < 256; bits++) {
+            uint32_t valid = 0;
+            for(uint32_t i = 0; i < historyLength; i++) {
+                valid += (bits >> i) & 1;
+            }
+            params_.persistLut[bits] = valid >= validCount ? 1 : 0;
+        }
+    }
+
+    // Forget the previous frames, must not be called while a frame is processed
+    void reset() override {
+        std::fill(history_.begin(), history_.end(), static_cast<uint16_t>(0));
+        std::fill(validBits_.begin(), validBits_.end(), static_cast<uint8_t>(0));
+    }
+
+protected:
+    void loadParams() override {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        frameParams_ = params_;
+    }
+
+    void processImage(const DepthImage &image) override {
+        // The history only covers the processed region
+        if(image.frameWidth != frameWidth_ || image.frameHeight != frameHeight_ || image.x != region_.x || image.y != region_.y || image.width != region_.width
+           || image.height != region_.height) {
+            frameWidth_    = image.frameWidth;
+            frameHeight_   = image.frameHeight;
+            region_.x      = image.x;
+            region_.y      = image.y;
+            region_.width  = image.width;
+            region_.height = image.height;
+            history_.assign(static_cast<size_t>(image.width) * image.height, 0);
+            validBits_.assign(static_cast<size_t>(image.width) * image.height, 0);
+        }
+        DepthFilter::processImage(image);
+    }
+
+    void processRows(const DepthImage &image, uint32_t rowBegin, uint32_t rowEnd) override {
+        for(uint32_t y = rowBegin; y < rowEnd; y++) {
+            size_t offset        = static_cast<size_t>(y) * image.stride;
+            size_t historyOffset = static_cast<size_t>(y) * image.width;
+            smoothRow(image.src + offset, image.dst + offset, &history_[historyOffset], image.width);
+            if(frameParams_.persistence) {
+                persistRow(image.src + offset, image.dst + offset, &history_[historyOffset], &validBits_[historyOffset], image.width);
+            }
+        }
+    }
+
+private:
+    struct Params {
+        uint16_t diffScale;
+        uint16_t weight;
+        bool     smooth;
+        bool     persistence;
+        uint8_t  persistLut[256];  // indexed by the validity bits of the previous frames, bit 0 is the previous frame
+    };
+
+    std::mutex            paramsMutex_;
+    Params                params_;
+    Params                frameParams_;
+    uint32_t              frameWidth_;
+    uint32_t              frameHeight_;
+    OBRect                region_;
+    std::vector<uint16_t> history_;
+    std::vector<uint8_t>  validBits_;
+
+    static uint16_t toQ16(float value) {
+        return static_cast<uint16_t>(std::min(65535.0f, std::max(0.0f, std::round(value * 65536.0f))));
+    }
+
+    // Smooth a row into dst and store it as history. Invalid pixels output 0, their history keeps the previous depth when
+    // the persistence is enabled (persistRow() decides then) and is cleared otherwise.
+    void smoothRow(const uint16_t *src, uint16_t *dst, uint16_t *history, uint32_t width) const {
+        const uint32_t diffScale = frameParams_.diffScale;
+        const uint32_t weight    = frameParams_.weight;
+        uint32_t       x         = 0;
+#if defined(OB_EXAMPLES_SSE2)
+        const __m128i zero    = _mm_setzero_si128();
+        const __m128i vDiff   = _mm_set1_epi16(static_cast<short>(diffScale));
+        const __m128i vWeight = _mm_set1_epi16(static_cast<short>(weight));
+        const __m128i vSmooth = _mm_set1_epi16(frameParams_.smooth ? -1 : 0);
+        const __m128i vKeep   = _mm_set1_epi16(frameParams_.persistence ? -1 : 0);
+        for(; x + 8 <= width; x += 8) {
+            __m128i cur   = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+            __m128i prev  = _mm_loadu_si128(reinterpret_cast<const __m128i *>(history + x));
+            __m128i up    = _mm_subs_epu16(cur, prev);
+            __m128i down  = _mm_subs_epu16(prev, cur);
+            __m128i limit = _mm_mulhi_epu16(prev, vDiff);
+            __m128i close = _mm_and_si128(_mm_cmpeq_epi16(_mm_subs_epu16(_mm_or_si128(up, down), limit), zero), vSmooth);
+            __m128i blend = _mm_sub_epi16(_mm_add_epi16(prev, _mm_mulhi_epu16(up, vWeight)), _mm_mulhi_epu16(down, vWeight));
+            __m128i out   = _mm_or_si128(_mm_and_si128(close, blend), _mm_andnot_si128(close, cur));
+            __m128i keep  = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi16(cur, zero), vKeep), prev);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), out);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(history + x), _mm_or_si128(out, keep));
+        }
+#elif defined(OB_EXAMPLES_NEON)
+        const uint16x8_t zero    = vdupq_n_u16(0);
+        const uint16x4_t vDiff   = vdup_n_u16(static_cast<uint16_t>(diffScale));
+        const uint16x4_t vWeight = vdup_n_u16(static_cast<uint16_t>(weight));
+        const uint16x8_t vSmooth = vdupq_n_u16(frameParams_.smooth ? 0xffff : 0);
+        const uint16x8_t vKeep   = vdupq_n_u16(frameParams_.persistence ? 0xffff : 0);
+        for(; x + 8 <= width; x += 8) {
+            uint16x8_t cur   = vld1q_u16(src + x);
+            uint16x8_t prev  = vld1q_u16(history + x);
+            uint16x8_t up    = vqsubq_u16(cur, prev);
+            uint16x8_t down  = vqsubq_u16(prev, cur);
+            uint16x8_t limit = mulhi(prev, vDiff);
+            uint16x8_t close = vandq_u16(vceqq_u16(vqsubq_u16(vorrq_u16(up, down), limit), zero), vSmooth);
+            uint16x8_t blend = vsubq_u16(vaddq_u16(prev, mulhi(up, vWeight)), mulhi(down, vWeight));
+            uint16x8_t out   = vbslq_u16(close, blend, cur);
+            uint16x8_t keep  = vandq_u16(vandq_u16(vceqq_u16(cur, zero), vKeep), prev);
+            vst1q_u16(dst + x, out);
+            vst1q_u16(history + x, vorrq_u16(out, keep));
+        }
+#endif
+        // Same arithmetic as the vector kernels, so every pixel gets the same result whatever the path
+        for(; x < width; x++) {
+            uint32_t cur   = src[x];
+            uint32_t prev  = history[x];
+            uint32_t up    = cur > prev ? cur - prev : 0;
+            uint32_t down  = prev > cur ? prev - cur : 0;
+            bool     close = frameParams_.smooth && (up | down) <= ((prev * diffScale) >> 16);
+            uint32_t out   = close ? prev + ((up * weight) >> 16) - ((down * weight) >> 16) : cur;
+            dst[x]         = static_cast<uint16_t>(out);
+            history[x]     = static_cast<uint16_t>(cur == 0 && frameParams_.persistence ? prev : out);
+        }
+    }
+
+    // Decide for the invalid pixels of a row whether they keep their last depth, and record the validity of the frame
+    void persistRow(const uint16_t *src, uint16_t *dst, uint16_t *history, uint8_t *validBits, uint32_t width) const {
+        for(uint32_t x = 0; x < width; x++) {
+            uint8_t bits = validBits[x];
+            if(src[x] == 0) {
+                if(frameParams_.persistLut[bits]) {
+                    dst[x] = history[x];
+                }
+                else {
+                    history[x] = 0;
+                }
+            }
+            validBits[x] = static_cast<uint8_t>((bits << 1) | (src[x] != 0 ? 1 : 0));
+        }
+    }
+
+#if defined(OB_EXAMPLES_NEON)
+    // High 16 bits of the products of x by a Q16 factor
+    static uint16x8_t mulhi(uint16x8_t x, uint16x4_t factor) {
+        return vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(x), factor), 16), vshrn_n_u32(vmull_u16(vget_high_u16(x), factor), 16));
+    }
+#endif
+};
@@ -0,0 +1,310 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+#include "executor.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+// Turn the unpacking of the packed depth or IR formats by the SDK on or off. With the unpacking off the frames are delivered
+// in their packed format (Y10, Y11, Y12, Y14, RLE, RVL), to be consumed as they are or unpacked by a FrameUnpacker.
+// sensor is OB_SENSOR_DEPTH, OB_SENSOR_IR, OB_SENSOR_IR_LEFT or OB_SENSOR_IR_RIGHT, false is returned for the other sensors.
+inline bool setSdkUnpack(std::shared_ptr<ob::Device> device, OBSensorType sensor, bool unpack) {
+    OBPropertyID propertyId;
+    switch(sensor) {
+    case OB_SENSOR_DEPTH:
+        propertyId = OB_PROP_SDK_DEPTH_FRAME_UNPACK_BOOL;
+        break;
+    case OB_SENSOR_IR:
+        propertyId = OB_PROP_SDK_IR_FRAME_UNPACK_BOOL;
+        break;
+    case OB_SENSOR_IR_LEFT:
+        propertyId = OB_PROP_SDK_IR_LEFT_FRAME_UNPACK_BOOL;
+        break;
+    case OB_SENSOR_IR_RIGHT:
+        propertyId = OB_PROP_SDK_IR_RIGHT_FRAME_UNPACK_BOOL;
+        break;
+    default:
+        return false;
+    }
+    device->setBoolProperty(propertyId, unpack);
+    return true;
+}
+
+// Host side unpacking of the packed depth and IR formats into Y16.
+//
+// Y10, Y11, Y12 and Y14 are a big-endian bit stream: pixel i holds the bits [i * bits, (i + 1) * bits) of the frame, most
+// significant bit first, so 8 pixels take `bits` bytes. They are unpacked 8 pixels at a time with byte shuffles (SSSE3 when
+// the CPU supports it, checked at runtime, NEON), or with 64-bit loads otherwise, over chunks of the frame on the executor.
+// RVL is the run length and variable length coding of depth of A. Wilson: 4-bit codes in 32-bit words, zero runs and
+// zigzag deltas. Its decoding is serial. The layout of RLE is not public, RLE frames are returned unchanged.
+// Frames of the other formats are returned unchanged. The depth value scale is not carried by the new frames.
+class FrameUnpacker {
+public:
+    explicit FrameUnpacker(std::shared_ptr<Executor> executor = nullptr) : executor_(executor) {}
+
+    // Bits per pixel of the bit packed formats, 0 for the other formats
+    static uint32_t packedBits(OBFormat format) {
+        switch(format) {
+        case OB_FORMAT_Y10:
+            return 10;
+        case OB_FORMAT_Y11:
+            return 11;
+        case OB_FORMAT_Y12:
+            return 12;
+        case OB_FORMAT_Y14:
+            return 14;
+        default:
+            return 0;
+        }
+    }
+
+    std::shared_ptr<ob::Frame> process(std::shared_ptr<ob::Frame> frame) {
+        if(frame == nullptr || (frame->type() != OB_FRAME_DEPTH && frame->type() != OB_FRAME_IR && frame->type() != OB_FRAME_IR_LEFT
+                                && frame->type() != OB_FRAME_IR_RIGHT)) {
+            return frame;
+        }
+        uint32_t bits = packedBits(frame->format());
+        if(bits == 0 && frame->format() != OB_FORMAT_RVL) {
+            return frame;
+        }
+
+        auto     videoFrame = frame->as<ob::VideoFrame>();
+        uint32_t width      = videoFrame->width();
+        uint32_t height     = videoFrame->height();
+        size_t   count      = static_cast<size_t>(width) * height;
+        if(count == 0 || (bits > 0 && frame->dataSize() < (count * bits + 7) / 8)) {
+            return frame;
+        }
+
+        auto output = ob::FrameHelper::createFrame(frame->type(), OB_FORMAT_Y16, width, height, 0);
+        ob::FrameHelper::setFrameDeviceTimestampUs(output, frame->timeStampUs());
+        ob::FrameHelper::setFrameSystemTimestamp(output, frame->systemTimeStamp());
+        auto src = reinterpret_cast<const uint8_t *>(frame->data());
+        auto dst = reinterpret_cast<uint16_t *>(output->data());
+        if(bits == 0) {
+            return decodeRvl(src, frame->dataSize(), count, dst) ? output : frame;
+        }
+        unpack(src, frame->dataSize(), bits, count, dst);
+        return output;
+    }
+
+    // unpackBits() over chunks of the image on the executor
+    void unpack(const uint8_t *src, size_t srcSize, uint32_t bits, size_t count, uint16_t *dst) {
+        if(!executor_) {
+            unpackBits(src, srcSize, bits, count, dst);
+            return;
+        }
+        // Chunks of whole groups of 8 pixels start on a byte
+        parallelFor(*executor_, 0, (count + 7) / 8, 4096, [src, srcSize, bits, count, dst](size_t begin, size_t end) {
+            size_t offset = begin * bits;
+            unpackBits(src + offset, srcSize - offset, bits, std::min(count, end * 8) - begin * 8, dst + begin * 8);
+        });
+    }
+
+    // Instruction set of the unpackBits() kernel used on this CPU
+    static const char *kernel() {
+#if defined(OB_EXAMPLES_NEON)
+        return "NEON";
+#elif defined(OB_EXAMPLES_SSSE3_KERNEL)
+        return cpuSupportsSsse3() ? "SSSE3" : "64-bit scalar";
+#else
+        return "64-bit scalar";
+#endif
+    }
+
+    // Unpack count pixels of bits bits (10 to 16) from src, which holds srcSize >= (count * bits + 7) / 8 bytes
+    static void unpackBits(const uint8_t *src, size_t srcSize, uint32_t bits, size_t count, uint16_t *dst) {
+#if defined(OB_EXAMPLES_NEON)
+        size_t i = unpackGroupsNeon(src, srcSize, bits, count, dst);
+#elif defined(OB_EXAMPLES_SSSE3_KERNEL)
+        size_t i = cpuSupportsSsse3() ? unpackGroupsSsse3(src, srcSize, bits, count, dst) : unpackGroups64(src, srcSize, bits, count, dst);
+#else
+        size_t i = unpackGroups64(src, srcSize, bits, count, dst);
+#endif
+        // Bit reader for the last pixels
+        src += (i / 8) * bits;
+        uint32_t accumulator = 0;
+        uint32_t available   = 0;
+        for(; i < count; i++) {
+            while(available < bits) {
+                accumulator = (accumulator << 8) | *src++;
+                available += 8;
+            }
+            available -= bits;
+            dst[i] = static_cast<uint16_t>((accumulator >> available) & ((1u << bits) - 1));
+        }
+    }
+
+    // Decode an RVL stream of srcSize bytes into count pixels, returns false when the stream ends before count pixels
+    static bool decodeRvl(const uint8_t *src, size_t srcSize, size_t count, uint16_t *dst) {
+        RvlReader reader = { src, src + srcSize / 4 * 4, 0, 0 };
+        uint16_t  previous = 0;
+        size_t    i        = 0;
+        while(i < count) {
+            uint32_t zeros;
+            uint32_t values;
+            if(!reader.read(zeros) || zeros > count - i) {
+                return false;
+            }
+            memset(dst + i, 0, zeros * sizeof(uint16_t));
+            i += zeros;
+            if(!reader.read(values) || values > count - i) {
+                return false;
+            }
+            for(uint32_t n = 0; n < values; n++) {
+                uint32_t code;
+                if(!reader.read(code)) {
+                    return false;
+                }
+                // Zigzag delta to the previous valid pixel
+                previous = static_cast<uint16_t>(previous + static_cast<int32_t>((code >> 1) ^ (0u - (code & 1))));
+                dst[i++] = previous;
+            }
+        }
+        return true;
+    }
+
+private:
+    std::shared_ptr<Executor> executor_;
+
+    // Variable length values of RVL: 3 bits per nibble, least significant first, the high bit of the nibble continues
+    struct RvlReader {
+        const uint8_t *next;
+        const uint8_t *end;
+        uint32_t       word;
+        uint32_t       nibbles;
+
+        bool read(uint32_t &value) {
+            value          = 0;
+            uint32_t shift = 0;
+            uint32_t nibble;
+            do {
+                if(shift > 30) {
+                    return false;
+                }
+                if(nibbles == 0) {
+                    if(next == end) {
+                        return false;
+                    }
+                    word = static_cast<uint32_t>(next[0]) | (static_cast<uint32_t>(next[1]) << 8) | (static_cast<uint32_t>(next[2]) << 16)
+                           | (static_cast<uint32_t>(next[3]) << 24);
+                    next += 4;
+                    nibbles = 8;
+                }
+                nibble = word >> 28;
+                word <<= 4;
+                nibbles--;
+                value |= (nibble & 0x7) << shift;
+                shift += 3;
+            } while(nibble & 0x8);
+            return true;
+        }
+    };
+
+#if defined(OB_EXAMPLES_SSSE3_KERNEL) || defined(OB_EXAMPLES_NEON)
+    // Pixel j of a group lies in the bytes k, k + 1 and k + 2 at the bit offset o: the shuffles put bytes k and k + 1 in the
+    // word w and byte k + 2 in the word n of lane j, then ((w << o) | (n >> (8 - o))) >> (16 - bits) is the pixel.
+    static void groupShuffles(uint32_t bits, uint8_t *wIndex, uint8_t *nIndex, uint32_t *offsets) {
+        for(uint32_t j = 0; j < 8; j++) {
+            uint32_t k        = j * bits / 8;
+            offsets[j]        = j * bits % 8;
+            wIndex[2 * j]     = static_cast<uint8_t>(k + 1);
+            wIndex[2 * j + 1] = static_cast<uint8_t>(k);
+            nIndex[2 * j]     = static_cast<uint8_t>(k + 2);
+            nIndex[2 * j + 1] = 0x80;
+        }
+    }
+#endif
+
+#if defined(OB_EXAMPLES_SSSE3_KERNEL)
+    // Groups of 8 pixels, returns the number of pixels unpacked. Compiled for SSSE3 whatever the target of the build, only
+    // called when the CPU supports it.
+    OB_EXAMPLES_TARGET_SSSE3 static size_t unpackGroupsSsse3(const uint8_t *src, size_t srcSize, uint32_t bits, size_t count, uint16_t *dst) {
+        uint8_t  wIndex[16];
+        uint8_t  nIndex[16];
+        uint32_t offsets[8];
+        uint16_t wShift[8];  // w << o as a factor 2^o
+        uint16_t nShift[8];  // n >> (8 - o) as a factor 2^(o + 8) of a high multiply
+        groupShuffles(bits, wIndex, nIndex, offsets);
+        for(uint32_t j = 0; j < 8; j++) {
+            wShift[j] = static_cast<uint16_t>(1u << offsets[j]);
+            nShift[j] = static_cast<uint16_t>(1u << (offsets[j] + 8));
+        }
+        const __m128i wShuffle = _mm_loadu_si128(reinterpret_cast<const __m128i *>(wIndex));
+        const __m128i nShuffle = _mm_loadu_si128(reinterpret_cast<const __m128i *>(nIndex));
+        const __m128i wFactor  = _mm_loadu_si128(reinterpret_cast<const __m128i *>(wShift));
+        const __m128i nFactor  = _mm_loadu_si128(reinterpret_cast<const __m128i *>(nShift));
+        const __m128i right    = _mm_cvtsi32_si128(static_cast<int>(16 - bits));
+        size_t        i        = 0;
+        for(; i + 8 <= count && (i / 8) * bits + 16 <= srcSize; i += 8) {
+            __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + (i / 8) * bits));
+            __m128i w  = _mm_mullo_epi16(_mm_shuffle_epi8(in, wShuffle), wFactor);
+            __m128i n  = _mm_mulhi_epu16(_mm_shuffle_epi8(in, nShuffle), nFactor);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_srl_epi16(_mm_or_si128(w, n), right));
+        }
+        return i;
+    }
+#endif
+
+#if defined(OB_EXAMPLES_NEON)
+    static size_t unpackGroupsNeon(const uint8_t *src, size_t srcSize, uint32_t bits, size_t count, uint16_t *dst) {
+        uint8_t  wIndex[16];
+        uint8_t  nIndex[16];
+        uint32_t offsets[8];
+        uint16_t wShift[8];  // w << o as a shift count
+        uint16_t nShift[8];  // n >> (8 - o) as a shift count o - 8
+        groupShuffles(bits, wIndex, nIndex, offsets);
+        for(uint32_t j = 0; j < 8; j++) {
+            wShift[j] = static_cast<uint16_t>(offsets[j]);
+            nShift[j] = static_cast<uint16_t>(static_cast<int16_t>(offsets[j]) - 8);
+        }
+        const uint8x8_t wLow   = vld1_u8(wIndex);
+        const uint8x8_t wHigh  = vld1_u8(wIndex + 8);
+        const uint8x8_t nLow   = vld1_u8(nIndex);
+        const uint8x8_t nHigh  = vld1_u8(nIndex + 8);
+        const int16x8_t wLeft  = vreinterpretq_s16_u16(vld1q_u16(wShift));
+        const int16x8_t nRight = vreinterpretq_s16_u16(vld1q_u16(nShift));
+        const int16x8_t right  = vdupq_n_s16(static_cast<int16_t>(static_cast<int>(bits) - 16));
+        size_t          i      = 0;
+        for(; i + 8 <= count && (i / 8) * bits + 16 <= srcSize; i += 8) {
+            const uint8_t *p = src + (i / 8) * bits;
+            uint8x8x2_t    in;
+            in.val[0]    = vld1_u8(p);
+            in.val[1]    = vld1_u8(p + 8);
+            uint16x8_t w = vreinterpretq_u16_u8(vcombine_u8(vtbl2_u8(in, wLow), vtbl2_u8(in, wHigh)));
+            uint16x8_t n = vreinterpretq_u16_u8(vcombine_u8(vtbl2_u8(in, nLow), vtbl2_u8(in, nHigh)));
+            vst1q_u16(dst + i, vshlq_u16(vorrq_u16(vshlq_u16(w, wLeft), vshlq_u16(n, nRight)), right));
+        }
+        return i;
+    }
+#else
+    // 4 pixels of at most 16 bits from each 64-bit big-endian load
+    static size_t unpackGroups64(const uint8_t *src, size_t srcSize, uint32_t bits, size_t count, uint16_t *dst) {
+        const uint64_t mask = (1u << bits) - 1;
+        size_t         i    = 0;
+        for(; i + 8 <= count && (i / 8) * bits + bits / 2 + 8 <= srcSize; i += 8) {
+            const uint8_t *p     = src + (i / 8) * bits;
+            uint64_t       first = loadBigEndian64(p);
+            uint64_t       last  = loadBigEndian64(p + bits / 2) << (bits % 2 * 4);
+            for(uint32_t j = 0; j < 4; j++) {
+                dst[i + j]     = static_cast<uint16_t>((first >> (64 - (j + 1) * bits)) & mask);
+                dst[i + 4 + j] = static_cast<uint16_t>((last >> (64 - (j + 1) * bits)) & mask);
+            }
+        }
+        return i;
+    }
+
+    static uint64_t loadBigEndian64(const uint8_t *p) {
+        uint64_t value = 0;
+        for(uint32_t k = 0; k < 8; k++) {
+            value = (value << 8) | p[k];
+        }
+        return value;
+    }
+#endif
+};
@@ -0,0 +1,313 @@
+// Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+#pragma once
+
+#include "libobsensor/ObSensor.hpp"
+#include "libobsensor/hpp/Utils.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define OB_EXAMPLES_SHARED_MEMORY
+#endif
+
+// xy tables of a sensor and the memory holding them, from the process heap or a shared memory segment
+class XYTables {
+public:
+    XYTables(std::shared_ptr<const float> data, size_t floatCount, const OBXYTables &tables) : data_(data), floatCount_(floatCount), tables_(tables) {}
+
+    // For the CoordinateTransformHelper functions, which only read the tables. Tables mapped from shared memory are read-only.
+    OBXYTables *get() const {
+        return const_cast<OBXYTables *>(&tables_);
+    }
+
+    int width() const {
+        return tables_.width;
+    }
+
+    int height() const {
+        return tables_.height;
+    }
+
+    const float *data() const {
+        return data_.get();
+    }
+
+    size_t floatCount() const {
+        return floatCount_;
+    }
+
+    size_t memoryUsage() const {
+        return floatCount_ * sizeof(float);
+    }
+
+private:
+    std::shared_ptr<const float> data_;
+    size_t                       floatCount_;
+    OBXYTables                   tables_;
+};
+
+// xy tables shared by the process, computed by CoordinateTransformHelper::transformationInitXYTables() once per calibration,
+// sensor and resolution (the resolution of the sensor intrinsics).
+//
+// On Linux and macOS the tables can also be shared between processes through named POSIX shared memory: the first process
+// computes them and exports them, the others map the segment read-only instead of computing them. A segment holds the
+// calibration it was computed from and is only used for the same calibration. Name the segments with sharedName(), a hash of
+// the device serial number and of the calibration short enough for macOS (31 characters). A segment left incomplete by a
+// crashed process or holding another calibration is replaced. Segments persist until removeShared() or reboot.
+class XYTablesCache {
+public:
+    // Tables of the calibration and sensor, nullptr when the SDK cannot compute them
+    std::shared_ptr<const XYTables> get(const OBCalibrationParam &param, OBSensorType sensor) {
+        auto                        key = makeKey(param, sensor);
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto                        iter = tables_.find(key);
+        if(iter != tables_.end()) {
+            return iter->second;
+        }
+        auto tables = compute(param, sensor);
+        if(tables) {
+            tables_[key] = tables;
+        }
+        return tables;
+    }
+
+    // Tables from the shared memory segment name when it holds the tables of this calibration and sensor. Otherwise the tables
+    // are computed and exported to name, replacing the segment found there.
+    std::shared_ptr<const XYTables> getShared(const std::string &name, const OBCalibrationParam &param, OBSensorType sensor) {
+        auto key = makeKey(param, sensor);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto                        iter = tables_.find(key);
+            if(iter != tables_.end()) {
+                return iter->second;
+            }
+        }
+        auto tables = importShared(name, key);
+        if(!tables) {
+            tables = get(param, sensor);
+            if(tables) {
+                exportShared(name, key, *tables);
+            }
+            return tables;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto                        iter = tables_.find(key);
+        if(iter != tables_.end()) {
+            return iter->second;
+        }
+        tables_[key] = tables;
+        return tables;
+    }
+
+    // Shared memory segment name of the tables of a device (e.g. its serial number), calibration and sensor, like
+    // "/obxy-0123456789abcdef"
+    static std::string sharedName(const std::string &deviceId, const OBCalibrationParam &param, OBSensorType sensor) {
+        auto     key  = makeKey(param, sensor);
+        uint64_t hash = 14695981039346656037ull;  // 64 bit FNV-1a
+        auto     mix  = [&hash](const void *data, size_t size) {
+            for(size_t i = 0; i < size; i++) {
+                hash = (hash ^ static_cast<const uint8_t *>(data)[i]) * 1099511628211ull;
+            }
+        };
+        mix(deviceId.data(), deviceId.size());
+        mix(key.data(), key.size() * sizeof(float));
+        char name[32];
+        snprintf(name, sizeof(name), "/obxy-%016llx", static_cast<unsigned long long>(hash));
+        return name;
+    }
+
+    // Remove the shared memory segment name, the processes that mapped it keep their mapping
+    static bool removeShared(const std::string &name) {
+#if defined(OB_EXAMPLES_SHARED_MEMORY)
+        return shm_unlink(name.c_str()) == 0;
+#else
+        (void)name;
+        return false;
+#endif
+    }
+
+    // Bytes used by the cached tables, including the mapped ones
+    size_t memoryUsage() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t                      bytes = 0;
+        for(auto &entry: tables_) {
+            bytes += entry.second->memoryUsage();
+        }
+        return bytes;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return tables_.size();
+    }
+
+    // Release the tables, the users of the tables keep them alive
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tables_.clear();
+    }
+
+private:
+    static const uint32_t kMagic   = 0x5459424f;  // "OBYT", written last by the exporting process
+    static const uint32_t kVersion = 1;
+    static const uint32_t kMaxKey  = 32;
+
+    // Layout of a shared memory segment, followed by the table data
+    struct SharedHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t keySize;
+        float    key[kMaxKey];
+        int32_t  width;
+        int32_t  height;
+        uint64_t xOffset;  // offsets of the tables in the data, in floats
+        uint64_t yOffset;  //
+        uint64_t floatCount;
+    };
+
+    mutable std::mutex                                             mutex_;
+    std::map<std::vector<float>, std::shared_ptr<const XYTables>> tables_;
+
+    static std::vector<float> makeKey(const OBCalibrationParam &param, OBSensorType sensor) {
+        const OBCameraIntrinsic &intrinsic = param.intrinsics[sensor];
+        std::vector<float>       key;
+        key.push_back(static_cast<float>(sensor));
+        key.push_back(intrinsic.fx);
+        key.push_back(intrinsic.fy);
+        key.push_back(intrinsic.cx);
+        key.push_back(intrinsic.cy);
+        key.push_back(intrinsic.width);
+        key.push_back(intrinsic.height);
+        key.insert(key.end(), reinterpret_cast<const float *>(&param.distortion[sensor]),
+                   reinterpret_cast<const float *>(&param.distortion[sensor]) + sizeof(OBCameraDistortion) / sizeof(float));
+        key.insert(key.end(), reinterpret_cast<const float *>(&param.extrinsics[OB_SENSOR_DEPTH][sensor]),
+                   reinterpret_cast<const float *>(&param.extrinsics[OB_SENSOR_DEPTH][sensor]) + sizeof(OBExtrinsic) / sizeof(float));
+        return key;
+    }
+
+    static std::shared_ptr<const XYTables> compute(const OBCalibrationParam &param, OBSensorType sensor) {
+        const OBCameraIntrinsic &intrinsic = param.intrinsics[sensor];
+        if(intrinsic.width <= 0 || intrinsic.height <= 0) {
+            return nullptr;
+        }
+        uint32_t               floatCount = static_cast<uint32_t>(intrinsic.width) * intrinsic.height * 2;
+        std::shared_ptr<float> data(new float[floatCount], std::default_delete<float[]>());
+        uint32_t               dataSize = floatCount;
+        OBXYTables             tables;
+        if(!ob::CoordinateTransformHelper::transformationInitXYTables(param, sensor, data.get(), &dataSize, &tables)) {
+            return nullptr;
+        }
+        return std::make_shared<const XYTables>(data, floatCount, tables);
+    }
+
+    static std::shared_ptr<const XYTables> importShared(const std::string &name, const std::vector<float> &key) {
+#if defined(OB_EXAMPLES_SHARED_MEMORY)
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if(fd < 0) {
+            return nullptr;
+        }
+        struct stat info;
+        if(fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SharedHeader)) {
+            close(fd);
+            return nullptr;
+        }
+        size_t size    = static_cast<size_t>(info.st_size);
+        void  *address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if(address == MAP_FAILED) {
+            return nullptr;
+        }
+        std::shared_ptr<const uint8_t> mapping(static_cast<const uint8_t *>(address), [size](const uint8_t *p) { munmap(const_cast<uint8_t *>(p), size); });
+
+        // A segment being written by another process has no magic yet
+        auto header = reinterpret_cast<const SharedHeader *>(mapping.get());
+        if(__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != kMagic || header->version != kVersion || header->keySize != key.size()
+           || memcmp(header->key, key.data(), key.size() * sizeof(float)) != 0
+           || header->floatCount > (size - sizeof(SharedHeader)) / sizeof(float)) {
+            return nullptr;
+        }
+        // Both tables must lie in the data of the segment
+        uint64_t tableSize = static_cast<uint64_t>(header->width) * static_cast<uint64_t>(header->height);
+        if(header->width <= 0 || header->height <= 0 || header->xOffset > header->floatCount || header->yOffset > header->floatCount
+           || tableSize > header->floatCount - header->xOffset || tableSize > header->floatCount - header->yOffset) {
+            return nullptr;
+        }
+        std::shared_ptr<const float> data(mapping, reinterpret_cast<const float *>(mapping.get() + sizeof(SharedHeader)));
+        OBXYTables                   tables;
+        tables.xTable = const_cast<float *>(data.get() + header->xOffset);
+        tables.yTable = const_cast<float *>(data.get() + header->yOffset);
+        tables.width  = header->width;
+        tables.height = header->height;
+        return std::make_shared<const XYTables>(data, static_cast<size_t>(header->floatCount), tables);
+#else
+        (void)name;
+        (void)key;
+        return nullptr;
+#endif
+    }
+
+    // Create the segment name with the tables. Called when importShared() found no usable segment: an existing segment is
+    // incomplete (its exporter crashed, or is still writing it) or holds other tables, it is unlinked and exported again.
+    static bool exportShared(const std::string &name, const std::vector<float> &key, const XYTables &tables) {
+#if defined(OB_EXAMPLES_SHARED_MEMORY)
+        if(key.size() > kMaxKey) {
+            return false;
+        }
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if(fd < 0 && errno == EEXIST && shm_unlink(name.c_str()) == 0) {
+            fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        }
+        if(fd < 0) {
+            return false;
+        }
+        size_t size = sizeof(SharedHeader) + tables.memoryUsage();
+        if(ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+        void *address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(address == MAP_FAILED) {
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        auto header     = static_cast<SharedHeader *>(address);
+        header->version = kVersion;
+        header->keySize = static_cast<uint32_t>(key.size());
+        memcpy(header->key, key.data(), key.size() * sizeof(float));
+        header->width      = tables.width();
+        header->height     = tables.height();
+        header->xOffset    = static_cast<uint64_t>(tables.get()->xTable - tables.data());
+        header->yOffset    = static_cast<uint64_t>(tables.get()->yTable - tables.data());
+        header->floatCount = tables.floatCount();
+        memcpy(static_cast<uint8_t *>(address) + sizeof(SharedHeader), tables.data(), tables.memoryUsage());
+        __atomic_store_n(&header->magic, kMagic, __ATOMIC_RELEASE);
+        munmap(address, size);
+        return true;
+#else
+        (void)name;
+        (void)key;
+        (void)tables;
+        return false;
+#endif
+    }
+};
+
+inline XYTablesCache &xyTablesCache() {
+    static XYTablesCache cache;
+    return cache;
+}
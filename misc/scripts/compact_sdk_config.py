@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+# Copyright(c) 2020 Orbbec Corporation. All Rights Reserved.
+"""Compact OrbbecSDKConfig_v1.0.xml for deployment.
+
+The SDK parses the whole configuration file when the first ob::Context is created. Most of the file is comments, CDATA
+examples and per-product sections that a deployment never uses. This script writes an equivalent configuration that only
+keeps the elements the SDK reads, optionally limited to some products, and checks that every kept setting has the same
+value as in the source file.
+
+Usage:
+    python3 compact_sdk_config.py OrbbecSDKConfig_v1.0.xml -o OrbbecSDKConfig_compact.xml
+    python3 compact_sdk_config.py OrbbecSDKConfig_v1.0.xml -o OrbbecSDKConfig_compact.xml --keep OrbbecGemini335 OrbbecGemini335L
+    python3 compact_sdk_config.py OrbbecSDKConfig_v1.0.xml --list
+
+Pass the output file to ob::Context(configPath).
+"""
+
+import argparse
+import sys
+import xml.etree.ElementTree as ET
+
+# Configuration file standard versions this script knows how to compact
+SUPPORTED_STANDARD_VERSIONS = ("1.1",)
+
+
+def product_sections(root):
+    """Per-product sections are the children of <Device> that contain other elements."""
+    device = root.find("Device")
+    if device is None:
+        return []
+    return [child for child in device if len(child) > 0]
+
+
+def compact(element):
+    """Drop the text of elements that have children (indentation and CDATA examples), strip leaf values."""
+    if len(element) > 0:
+        element.text = None
+        for child in element:
+            compact(child)
+            child.tail = None
+    elif element.text is not None:
+        element.text = element.text.strip()
+
+
+def settings(element, path=""):
+    """Flatten an element tree to an ordered list of (path, value) for the leaf elements."""
+    path = path + "/" + element.tag
+    if len(element) == 0:
+        return [(path, (element.text or "").strip())]
+    result = []
+    for child in element:
+        result.extend(settings(child, path))
+    return result
+
+
+def indent(element, level=0):
+    pad = "\n" + "    " * level
+    if len(element) > 0:
+        element.text = pad + "    "
+        for child in element:
+            indent(child, level + 1)
+            child.tail = pad + "    "
+        element[-1].tail = pad
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compact the Orbbec SDK XML configuration file.")
+    parser.add_argument("input", help="source configuration file, e.g. misc/config/OrbbecSDKConfig_v1.0.xml")
+    parser.add_argument("-o", "--output", help="compacted configuration file")
+    parser.add_argument("--keep", nargs="+", metavar="PRODUCT", help="product sections of <Device> to keep, all by default")
+    parser.add_argument("--list", action="store_true", help="list the product sections and exit")
+    args = parser.parse_args()
+
+    source = ET.parse(args.input).getroot()
+    if source.tag != "Config":
+        sys.exit("error: %s is not an Orbbec SDK configuration file" % args.input)
+
+    version = (source.findtext("ConfigStandardVersion") or "").strip()
+    if version not in SUPPORTED_STANDARD_VERSIONS:
+        sys.exit("error: unsupported ConfigStandardVersion '%s', supported: %s" % (version, ", ".join(SUPPORTED_STANDARD_VERSIONS)))
+
+    products = [section.tag for section in product_sections(source)]
+    if args.list:
+        print("\n".join(products))
+        return
+    if not args.output:
+        parser.error("the following arguments are required: -o/--output")
+
+    if args.keep:
+        unknown = [name for name in args.keep if name not in products]
+        if unknown:
+            sys.exit("error: unknown product section(s): %s" % ", ".join(unknown))
+
+    # Work on a copy, the source tree is used for the verification
+    result = ET.fromstring(ET.tostring(source))
+    if args.keep:
+        device = result.find("Device")
+        for section in product_sections(result):
+            if section.tag not in args.keep:
+                device.remove(section)
+    compact(result)
+    indent(result)
+
+    data = b'<?xml version="1.0" encoding="UTF-8"?>\n' + ET.tostring(result, encoding="utf-8") + b"\n"
+
+    # Every kept setting must read back with the value of the source file
+    expected = settings(source)
+    if args.keep:
+        dropped = ["/Config/Device/" + name + "/" for name in products if name not in args.keep]
+        expected = [(key, value) for key, value in expected if not any(key.startswith(prefix) for prefix in dropped)]
+    actual = settings(ET.fromstring(data))
+    if actual != expected:
+        changed = [pair for pair in zip(actual, expected) if pair[0] != pair[1]]
+        sys.exit("error: compacted configuration differs from the source: %s" % changed[:10])
+
+    with open(args.output, "wb") as output:
+        output.write(data)
+
+    source_size = len(open(args.input, "rb").read())
+    print("%s: %d bytes -> %s: %d bytes, %d settings, %d product section(s)" %
+          (args.input, source_size, args.output, len(data), len(actual), len(product_sections(result))))
+
+
+if __name__ == "__main__":
+    main()